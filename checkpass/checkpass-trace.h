@@ -0,0 +1,43 @@
+/*****************************************************************
+ *
+ *	kcheckpass - Simple password checker
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *	Static tracepoints of the "ccheckpass" provider. They compile to
+ *	a single nop when <sys/sdt.h> is available and to nothing otherwise,
+ *	and can be attached with perf, bpftrace, SystemTap or LTTng
+ *	(--userspace-probe=sdt:...). The attempt id matches the one of the
+ *	"cutefish_screenlocker" probes in the greeter.
+ *
+ *****************************************************************/
+
+#ifndef CHECKPASS_TRACE_H_
+#define CHECKPASS_TRACE_H_
+
+#include <config-screenlocker.h>
+
+#if HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define CHECKPASS_TRACE(name) DTRACE_PROBE(ccheckpass, name)
+#define CHECKPASS_TRACE1(name, a) DTRACE_PROBE1(ccheckpass, name, a)
+#define CHECKPASS_TRACE2(name, a, b) DTRACE_PROBE2(ccheckpass, name, a, b)
+#else
+#define CHECKPASS_TRACE(name) do { } while (0)
+#define CHECKPASS_TRACE1(name, a) do { (void)(a); } while (0)
+#define CHECKPASS_TRACE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#endif
+
+#endif
@@ -46,6 +46,7 @@
  *****************************************************************/
 
 #include "checkpass.h"
+#include "checkpass-trace.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -54,7 +55,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <syslog.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -146,6 +147,39 @@ static int GRecvInt(void)
     return val;
 }
 
+/* One page, locked and left out of core dumps, that responses are read into */
+static char *recvbuf;
+static unsigned recvbuf_size;
+
+static void secure_zero(void *buf, size_t len)
+{
+#if HAVE_EXPLICIT_BZERO
+    explicit_bzero(buf, len);
+#else
+    volatile char *p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+#endif
+}
+
+static void recvbuf_init(void)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    recvbuf = mmap(0, pagesize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (recvbuf == MAP_FAILED) {
+        message("No memory for read buffer\n");
+        exit(15);
+    }
+    /* best effort, RLIMIT_MEMLOCK may not allow it */
+    mlock(recvbuf, pagesize);
+#if HAVE_MADV_DONTDUMP
+    madvise(recvbuf, pagesize, MADV_DONTDUMP);
+#endif
+    recvbuf_size = pagesize;
+}
+
 static char *GRecvStr(void)
 {
     unsigned len;
@@ -154,12 +188,21 @@ static char *GRecvStr(void)
     if (!(len = GRecvInt())) {
         return (char *)0;
     }
-    if (len > 0x1000 || !(buf = malloc(len))) {
+    if (len > 0x1000 || len > recvbuf_size) {
+        message("No memory for read buffer\n");
+        exit(15);
+    }
+    GRead(recvbuf, len);
+    recvbuf[len - 1] = 0; /* we're setuid ... don't trust "them" */
+
+    /* PAM frees the response itself, so it has to be a malloc'd copy
+       sized to the string; nothing else is left on the heap */
+    buf = strdup(recvbuf);
+    secure_zero(recvbuf, len);
+    if (!buf) {
         message("No memory for read buffer\n");
         exit(15);
     }
-    GRead(buf, len);
-    buf[len - 1] = 0; /* we're setuid ... don't trust "them" */
     return buf;
 }
 
@@ -189,8 +232,22 @@ static char *GRecvArr(void)
     return arr;
 }
 
+static int GetAttemptId(void)
+{
+    GSendInt(ConvGetAttemptId);
+    return GRecvInt();
+}
+
+static void conv_locked_out(int seconds)
+{
+    CHECKPASS_TRACE1(conv_request, ConvPutLockedOut);
+    GSendInt(ConvPutLockedOut);
+    GSendInt(seconds);
+}
+
 static char *conv_server(ConvRequest what, const char *prompt)
 {
+    CHECKPASS_TRACE1(conv_request, what);
     GSendInt(what);
     switch (what) {
     case ConvGetBinary: {
@@ -202,8 +259,10 @@ static char *conv_server(ConvRequest what, const char *prompt)
     case ConvGetNormal:
     case ConvGetHidden: {
         char *msg;
+        audit_phase_begin(AuditConv);
         GSendStr(prompt);
         msg = GRecvStr();
+        audit_phase_end(AuditConv);
         if (msg && (GRecvInt() & IsPassword) && !*msg) {
             nullpass = 1;
         }
@@ -214,6 +273,8 @@ static char *conv_server(ConvRequest what, const char *prompt)
     case ConvPutAuthError:
     case ConvPutAuthAbort:
     case ConvPutReadyForAuthentication:
+    case ConvGetAttemptId:
+    case ConvPutLockedOut:
         return 0;
     case ConvPutInfo:
     case ConvPutError:
@@ -259,6 +320,8 @@ int main(int argc, char **argv)
     char *p;
     struct passwd *pw;
     int c, nfd;
+    int attemptId;
+    int lockout;
     uid_t uid;
     AuthReturn ret;
     sigset_t signalMask;
@@ -287,6 +350,9 @@ int main(int argc, char **argv)
     procctl(P_PID, getpid(), PROC_TRACE_CTL, &mode);
 #endif
 
+    // before anything is read from the greeter
+    recvbuf_init();
+
     // prevent becoming an orphan while waiting for SIGUSR2
 #if HAVE_PR_SET_DUMPABLE
     prctl(PR_SET_PDEATHSIG, SIGUSR2);
@@ -354,6 +420,8 @@ int main(int argc, char **argv)
         conv_server(ConvPutAuthError, 0);
         return 1;
     }
+    // the audit writer thread must not take the signals
+    audit_init(username, uid);
 #if HAVE_SIGNALFD_H
     signalFd = signalfd(-1, &signalMask, SFD_CLOEXEC);
     if (signalFd == -1) {
@@ -396,6 +464,7 @@ int main(int argc, char **argv)
 #endif
     // now lets block on the fd
     for (;;) {
+        CHECKPASS_TRACE(ready);
         conv_server(ConvPutReadyForAuthentication, 0);
 #if HAVE_SIGNALFD_H
         sigReadSize = read(signalFd, &fdsi, sizeof(struct signalfd_siginfo));
@@ -444,20 +513,25 @@ int main(int argc, char **argv)
                 }
 #endif
                 /* Now do the fandango */
+                attemptId = GetAttemptId();
+                CHECKPASS_TRACE1(attempt_begin, attemptId);
+                audit_attempt_begin(attemptId);
                 ret = Authenticate(method, username, conv_server);
+                CHECKPASS_TRACE2(attempt_end, attemptId, ret);
 
                 if (ret == AuthBad) {
                     message("Authentication failure\n");
-                    if (!nullpass) {
-                        openlog("kcheckpass", LOG_PID, LOG_AUTH);
-                        syslog(LOG_NOTICE, "Authentication failure for %s (invoked by uid %d)", username, uid);
-                    }
                 }
                 switch (ret) {
                 case AuthOk:
                     conv_server(ConvPutAuthSucceeded, 0);
                     break;
                 case AuthBad:
+                    // lets the greeter wait instead of trying again for nothing
+                    lockout = faillock_remaining(username, uid);
+                    if (lockout > 0) {
+                        conv_locked_out(lockout);
+                    }
                     conv_server(ConvPutAuthFailed, 0);
                     break;
                 case AuthError:
@@ -468,6 +542,8 @@ int main(int argc, char **argv)
                 default:
                     break;
                 }
+                // queued once the greeter has its answer
+                audit_attempt_end(ret, ret == AuthBad && !nullpass);
                 if (uid != geteuid()) {
                     // we don't support multiple auth for setuid kcheckpass
                     break;
@@ -498,7 +574,8 @@ int main(int argc, char **argv)
 
     void dispose(char *str)
     {
-        memset(str, 0, strlen(str));
+        /* a plain memset before free() may be optimized away */
+        secure_zero(str, strlen(str));
         free(str);
     }
 
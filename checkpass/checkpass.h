@@ -99,6 +99,35 @@ void message(const char *, ...) ATTR_PRINTFLIKE(1, 2);
  *****************************************************************/
 void dispose(char *);
 
+/*****************************************************************
+ * Audit records of authentication attempts, see checkpass_audit.c
+ *****************************************************************/
+typedef enum {
+    AuditConv,
+    AuditPamStart,
+    AuditPamAuthenticate,
+    AuditPamSetcred,
+    AuditCrypt,
+    AuditPhaseCount
+} AuditPhase;
+
+void audit_init(const char *user, uid_t uid);
+void audit_attempt_begin(int attemptId);
+void audit_phase_begin(AuditPhase phase);
+void audit_phase_end(AuditPhase phase);
+void audit_attempt_end(AuthReturn result, int logFailure);
+
+/*****************************************************************
+ * Seconds the user stays locked out by pam_faillock, 0 unless the
+ * module reported the lock during this attempt
+ *****************************************************************/
+int faillock_remaining(const char *user, uid_t uid);
+
+/*****************************************************************
+ * Feeds a PAM message to faillock_remaining(), NULL forgets it
+ *****************************************************************/
+void faillock_note_message(const char *msg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,240 @@
+/*****************************************************************
+ *
+ *	kcheckpass - Simple password checker
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *	Audit records of authentication attempts. Every attempt yields
+ *	one key=value line in the auth log with the attempt id, the
+ *	backend, the time spent in each phase and the outcome. Nothing
+ *	typed ever goes into a record.
+ *
+ *	The authenticating thread only fills a slot of a fixed ring and
+ *	posts a semaphore; syslog() runs on a writer thread of its own. A
+ *	slow or stalled journald thus never delays an answer to the
+ *	greeter. When the ring is full the record is dropped and counted,
+ *	the next record carries the count.
+ *
+ *	The "Authentication failure" notice is not a timing record and is
+ *	never dropped: it is written directly, once the greeter has its
+ *	answer.
+ *
+ *****************************************************************/
+
+#include "checkpass.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#define AUDIT_RING_SIZE 16
+/* how long exit waits for records still queued */
+#define AUDIT_FLUSH_MS 25
+
+#ifdef HAVE_PAM
+#define AUDIT_BACKEND "pam"
+#else
+#define AUDIT_BACKEND "shadow"
+#endif
+
+struct audit_record {
+    int attempt;
+    AuthReturn result;
+    unsigned dropped;
+    long long phaseUs[AuditPhaseCount];
+    long long totalUs;
+};
+
+static const char *const phaseNames[AuditPhaseCount] = {
+    "conv_us",
+    "pam_start_us",
+    "pam_authenticate_us",
+    "pam_setcred_us",
+    "crypt_us",
+};
+
+static struct audit_record ring[AUDIT_RING_SIZE];
+static atomic_uint ringHead; /* next slot to fill, authenticating thread */
+static atomic_uint ringTail; /* next slot to write, writer thread */
+static atomic_uint droppedRecords;
+static sem_t pending;
+static int writerRunning;
+
+static const char *auditUser;
+static uid_t auditUid;
+
+static struct audit_record current;
+static long long attemptStart;
+static long long phaseStart[AuditPhaseCount];
+
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static const char *result_name(AuthReturn result)
+{
+    switch (result) {
+    case AuthOk:
+        return "ok";
+    case AuthBad:
+        return "bad";
+    case AuthError:
+        return "error";
+    case AuthAbort:
+        return "abort";
+    }
+    return "unknown";
+}
+
+static void write_record(const struct audit_record *record)
+{
+    char phases[256];
+    size_t len = 0;
+    int i;
+
+    phases[0] = 0;
+    for (i = 0; i < AuditPhaseCount; i++) {
+        if (record->phaseUs[i] < 0) {
+            continue;
+        }
+        len += snprintf(phases + len, sizeof(phases) - len, " %s=%lld", phaseNames[i], record->phaseUs[i]);
+        if (len >= sizeof(phases)) {
+            break;
+        }
+    }
+
+    syslog(LOG_INFO,
+           "attempt=%d backend=%s result=%s%s total_us=%lld dropped=%u",
+           record->attempt,
+           AUDIT_BACKEND,
+           result_name(record->result),
+           phases,
+           record->totalUs,
+           record->dropped);
+}
+
+static void *audit_writer(void *arg ATTR_UNUSED)
+{
+    unsigned tail;
+
+    for (;;) {
+        if (sem_wait(&pending)) {
+            continue; /* EINTR */
+        }
+        tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+        write_record(&ring[tail % AUDIT_RING_SIZE]);
+        atomic_store_explicit(&ringTail, tail + 1, memory_order_release);
+    }
+    return 0;
+}
+
+static void audit_flush(void)
+{
+    struct timespec pause = {0, 1000000};
+    int waited;
+
+    for (waited = 0; waited < AUDIT_FLUSH_MS; waited++) {
+        if (atomic_load_explicit(&ringTail, memory_order_acquire) == atomic_load_explicit(&ringHead, memory_order_relaxed)) {
+            return;
+        }
+        nanosleep(&pause, 0);
+    }
+}
+
+/* Call with SIGUSR1 and SIGUSR2 blocked, the writer inherits the mask */
+void audit_init(const char *user, uid_t uid)
+{
+    pthread_t thread;
+
+    auditUser = user;
+    auditUid = uid;
+
+    /* once for the process, PAM modules log under the same ident. It
+     * does not connect yet, the writer does that on its first record */
+    openlog("kcheckpass", LOG_PID, LOG_AUTH);
+
+    if (sem_init(&pending, 0, 0)) {
+        return;
+    }
+    if (pthread_create(&thread, 0, audit_writer, 0)) {
+        return;
+    }
+    pthread_detach(thread);
+    writerRunning = 1;
+    atexit(audit_flush);
+}
+
+void audit_attempt_begin(int attemptId)
+{
+    int i;
+
+    memset(&current, 0, sizeof(current));
+    current.attempt = attemptId;
+    for (i = 0; i < AuditPhaseCount; i++) {
+        current.phaseUs[i] = -1;
+    }
+    attemptStart = now_us();
+}
+
+void audit_phase_begin(AuditPhase phase)
+{
+    phaseStart[phase] = now_us();
+}
+
+void audit_phase_end(AuditPhase phase)
+{
+    long long elapsed = now_us() - phaseStart[phase];
+
+    /* conversations may happen more than once per attempt */
+    current.phaseUs[phase] = current.phaseUs[phase] < 0 ? elapsed : current.phaseUs[phase] + elapsed;
+}
+
+/* Call after the answer went to the greeter. Only the failure notice may
+ * block, the timing record is dropped when the writer is behind */
+void audit_attempt_end(AuthReturn result, int logFailure)
+{
+    unsigned head;
+
+    if (result == AuthBad && logFailure) {
+        syslog(LOG_NOTICE, "Authentication failure for %s (invoked by uid %d)", auditUser, (int)auditUid);
+    }
+
+    current.result = result;
+    current.totalUs = now_us() - attemptStart;
+
+    if (!writerRunning) {
+        write_record(&current);
+        return;
+    }
+
+    head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ringTail, memory_order_acquire) >= AUDIT_RING_SIZE) {
+        atomic_fetch_add_explicit(&droppedRecords, 1, memory_order_relaxed);
+        return;
+    }
+    current.dropped = atomic_exchange_explicit(&droppedRecords, 0, memory_order_relaxed);
+    ring[head % AUDIT_RING_SIZE] = current;
+    atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+    sem_post(&pending);
+}
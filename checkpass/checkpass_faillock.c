@@ -0,0 +1,232 @@
+/*****************************************************************
+ *
+ *	kcheckpass - Simple password checker
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *	Remaining pam_faillock lockout of the user, so the greeter can
+ *	count down instead of running the PAM stack for nothing.
+ *
+ *	Only the module itself says whether the user is locked out: a
+ *	lockout is reported only when this attempt's conversation carried
+ *	the "(N minutes left to unlock)" message of pam_faillock. Without
+ *	it (another stack, a silent module, a lock until an administrator
+ *	clears it) every attempt goes to PAM.
+ *
+ *	The module rounds the minutes up. The tally file, evaluated
+ *	against faillock.conf the way pam_faillock does, gives the exact
+ *	time when it agrees with the message; it may not, since module
+ *	arguments in the stack override faillock.conf. Otherwise the count
+ *	down ends a minute early at worst and the next attempt asks the
+ *	module again.
+ *
+ *****************************************************************/
+
+#include "checkpass.h"
+
+#ifdef HAVE_PAM
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FAILLOCK_CONF "/etc/security/faillock.conf"
+#define FAILLOCK_DEFAULT_DIR "/var/run/faillock"
+
+/* from pam_faillock's faillock.h */
+#define TALLY_STATUS_VALID 0x1
+
+struct tally {
+    char source[52];
+    uint16_t reserved;
+    uint16_t status;
+    uint64_t time;
+};
+
+struct faillock_conf {
+    char dir[256];
+    unsigned deny;
+    unsigned failInterval;
+    unsigned unlockTime; /* 0 for never */
+    unsigned rootUnlockTime;
+    int evenDenyRoot;
+};
+
+/* from this attempt's pam_faillock message, 0 when there was none */
+static int notedMinutes;
+
+static char *trim(char *s)
+{
+    char *end;
+
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = 0;
+    }
+    return s;
+}
+
+static unsigned parse_seconds(const char *value)
+{
+    return strcmp(value, "never") ? (unsigned)strtoul(value, 0, 10) : 0;
+}
+
+static void read_conf(struct faillock_conf *conf)
+{
+    char line[512];
+    char *key, *value, *p;
+    int haveRootUnlockTime = 0;
+    FILE *f;
+
+    strcpy(conf->dir, FAILLOCK_DEFAULT_DIR);
+    conf->deny = 3;
+    conf->failInterval = 900;
+    conf->unlockTime = 600;
+    conf->rootUnlockTime = 600;
+    conf->evenDenyRoot = 0;
+
+    if (!(f = fopen(FAILLOCK_CONF, "re"))) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if ((p = strchr(line, '#'))) {
+            *p = 0;
+        }
+        value = "";
+        if ((p = strchr(line, '='))) {
+            *p = 0;
+            value = trim(p + 1);
+        }
+        key = trim(line);
+
+        if (!strcmp(key, "dir") && *value) {
+            snprintf(conf->dir, sizeof(conf->dir), "%s", value);
+        } else if (!strcmp(key, "deny")) {
+            conf->deny = (unsigned)strtoul(value, 0, 10);
+        } else if (!strcmp(key, "fail_interval")) {
+            conf->failInterval = (unsigned)strtoul(value, 0, 10);
+        } else if (!strcmp(key, "unlock_time")) {
+            conf->unlockTime = parse_seconds(value);
+        } else if (!strcmp(key, "root_unlock_time")) {
+            conf->rootUnlockTime = parse_seconds(value);
+            haveRootUnlockTime = 1;
+        } else if (!strcmp(key, "even_deny_root")) {
+            conf->evenDenyRoot = 1;
+        }
+    }
+    fclose(f);
+
+    if (!haveRootUnlockTime) {
+        conf->rootUnlockTime = conf->unlockTime;
+    }
+}
+
+/* -1 when the tally file cannot be read */
+static int tally_remaining(const char *user, uid_t uid)
+{
+    struct faillock_conf conf;
+    struct tally record;
+    char path[512];
+    unsigned failures = 0;
+    unsigned unlockTime;
+    uint64_t latest = 0;
+    time_t now;
+    long long left;
+    FILE *f;
+
+    read_conf(&conf);
+    if (!conf.deny || (uid == 0 && !conf.evenDenyRoot)) {
+        return 0;
+    }
+    unlockTime = uid == 0 ? conf.rootUnlockTime : conf.unlockTime;
+    if (!unlockTime) {
+        /* locked until an administrator resets it, nothing to count down */
+        return 0;
+    }
+
+    if (snprintf(path, sizeof(path), "%s/%s", conf.dir, user) >= (int)sizeof(path)) {
+        return -1;
+    }
+    /* pam_faillock hands the file to the user it belongs to */
+    if (!(f = fopen(path, "re"))) {
+        return -1;
+    }
+    now = time(0);
+    while (fread(&record, sizeof(record), 1, f) == 1) {
+        if (!(record.status & TALLY_STATUS_VALID)) {
+            continue;
+        }
+        if ((uint64_t)now >= record.time && (uint64_t)now - record.time >= conf.failInterval) {
+            continue;
+        }
+        failures++;
+        if (record.time > latest) {
+            latest = record.time;
+        }
+    }
+    fclose(f);
+
+    if (failures < conf.deny) {
+        return 0;
+    }
+    left = (long long)latest + unlockTime - now;
+    return left > 0 ? (int)left : 0;
+}
+
+void faillock_note_message(const char *msg)
+{
+    int minutes;
+
+    if (!msg) {
+        notedMinutes = 0;
+    } else if (sscanf(msg, "(%d minute", &minutes) == 1 && minutes > 0) {
+        notedMinutes = minutes;
+    }
+}
+
+int faillock_remaining(const char *user, uid_t uid)
+{
+    int remaining;
+
+    if (notedMinutes <= 0) {
+        return 0;
+    }
+
+    /* only a tally within the minute the module reported refines it */
+    remaining = tally_remaining(user, uid);
+    if (remaining > (notedMinutes - 1) * 60 && remaining <= notedMinutes * 60) {
+        return remaining;
+    }
+    return (notedMinutes - 1) * 60;
+}
+
+#else
+
+void faillock_note_message(const char *msg ATTR_UNUSED)
+{
+}
+
+int faillock_remaining(const char *user ATTR_UNUSED, uid_t uid ATTR_UNUSED)
+{
+    return 0;
+}
+
+#endif
@@ -18,13 +18,13 @@
  */
 
 #include "checkpass.h"
+#include "checkpass-trace.h"
 
 #ifdef HAVE_PAM
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <syslog.h>
 
 #ifdef HAVE_PAM_PAM_APPL_H
 #include <pam/pam_appl.h>
@@ -59,9 +59,11 @@ static int PAM_conv(int num_msg, pam_message_type **msg, struct pam_response **r
     for (count = 0; count < num_msg; count++) {
         switch (msg[count]->msg_style) {
         case PAM_TEXT_INFO:
+            faillock_note_message(msg[count]->msg);
             pd->conv(ConvPutInfo, msg[count]->msg);
             break;
         case PAM_ERROR_MSG:
+            faillock_note_message(msg[count]->msg);
             pd->conv(ConvPutError, msg[count]->msg);
             break;
         default:
@@ -134,8 +136,7 @@ AuthReturn Authenticate(const char *method, const char *user, char *(*conv)(Conv
     char pservb[64];
     int pam_error;
 
-    openlog("kcheckpass", LOG_PID, LOG_AUTH);
-
+    faillock_note_message(0);
     PAM_data.conv = conv;
     if (strcmp(method, "classic")) {
         sprintf(pservb, "%.31s-%.31s", KSCREENSAVER_PAM_SERVICE, method);
@@ -144,7 +145,11 @@ AuthReturn Authenticate(const char *method, const char *user, char *(*conv)(Conv
         /* PAM_data.classic = 1; */
         pam_service = KSCREENSAVER_PAM_SERVICE;
     }
+    CHECKPASS_TRACE(pam_start_begin);
+    audit_phase_begin(AuditPamStart);
     pam_error = pam_start(pam_service, user, &PAM_conversation, &pamh);
+    audit_phase_end(AuditPamStart);
+    CHECKPASS_TRACE1(pam_start_end, pam_error);
     if (pam_error != PAM_SUCCESS) {
         return AuthError;
     }
@@ -164,7 +169,11 @@ AuthReturn Authenticate(const char *method, const char *user, char *(*conv)(Conv
     pam_set_item(pamh, PAM_FAIL_DELAY, (void *)fail_delay);
 #endif
 
+    CHECKPASS_TRACE(pam_authenticate_begin);
+    audit_phase_begin(AuditPamAuthenticate);
     pam_error = pam_authenticate(pamh, 0);
+    audit_phase_end(AuditPamAuthenticate);
+    CHECKPASS_TRACE1(pam_authenticate_end, pam_error);
     if (pam_error != PAM_SUCCESS) {
         if (PAM_data.abort) {
             PAM_data.abort = 0;
@@ -194,7 +203,11 @@ AuthReturn Authenticate(const char *method, const char *user, char *(*conv)(Conv
         return AuthBad;
     }
 
+    CHECKPASS_TRACE(pam_setcred_begin);
+    audit_phase_begin(AuditPamSetcred);
     pam_error = pam_setcred(pamh, PAM_REFRESH_CRED);
+    audit_phase_end(AuditPamSetcred);
+    CHECKPASS_TRACE1(pam_setcred_end, pam_error);
     /* ignore errors on refresh credentials. If this did not work we use the old ones. */
 
     pam_end(pamh, PAM_SUCCESS);
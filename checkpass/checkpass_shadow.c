@@ -25,6 +25,7 @@
  */
 
 #include "checkpass.h"
+#include "checkpass-trace.h"
 
 /*******************************************************************
  * This is the authentication code for Shadow-Passwords
@@ -62,11 +63,15 @@ AuthReturn Authenticate(const char *method, const char *login, char *(*conv)(Con
     if (!(typed_in_password = conv(ConvGetHidden, 0)))
         return AuthAbort;
 
+    CHECKPASS_TRACE(crypt_begin);
+    audit_phase_begin(AuditCrypt);
 #if defined(__linux__) && defined(HAVE_PW_ENCRYPT)
     crpt_passwd = pw_encrypt(typed_in_password, password); /* (1) */
 #else
     crpt_passwd = crypt(typed_in_password, password);
 #endif
+    audit_phase_end(AuditCrypt);
+    CHECKPASS_TRACE(crypt_end);
 
     if (crpt_passwd && !strcmp(password, crpt_passwd)) {
         dispose(typed_in_password);
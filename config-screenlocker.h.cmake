@@ -13,4 +13,11 @@
 #cmakedefine01 HAVE_SYS_PROCCTL_H
 #cmakedefine01 HAVE_PROC_TRACE_CTL
 #cmakedefine01 HAVE_SIGNALFD_H
-#cmakedefine01 HAVE_EVENT_H
\ No newline at end of file
+#cmakedefine01 HAVE_EVENT_H
+#cmakedefine01 HAVE_EXPLICIT_BZERO
+#cmakedefine01 HAVE_MADV_DONTDUMP
+#cmakedefine01 HAVE_SYS_SDT_H
+#cmakedefine01 HAVE_XCB_SHM
+#cmakedefine01 ENABLE_DBUS_AUDIT
+#cmakedefine01 ENABLE_ALLOC_COUNT
+#cmakedefine01 ENABLE_STALL_WATCHDOG
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "activitymonitor.h"
+
+#include <QAbstractEventDispatcher>
+#include <QEvent>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQuickItem>
+#include <QQuickView>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
+
+// system
+#include <time.h>
+
+static qint64 processCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static double perMinute(quint64 count, qint64 elapsedMs)
+{
+    return elapsedMs > 0 ? count * 60000.0 / elapsedMs : 0.0;
+}
+
+static QJsonArray sourcesToJson(const QHash<QPair<const char *, QString>, quint64> &sources, qint64 elapsedMs)
+{
+    QList<QPair<QPair<const char *, QString>, quint64>> sorted;
+    for (auto it = sources.constBegin(); it != sources.constEnd(); ++it) {
+        sorted.append(qMakePair(it.key(), it.value()));
+    }
+    std::sort(sorted.begin(), sorted.end(), [] (const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
+
+    QJsonArray array;
+    for (const auto &entry : std::as_const(sorted)) {
+        QString source = QString::fromLatin1(entry.first.first);
+        if (!entry.first.second.isEmpty()) {
+            source += QLatin1Char('/') + entry.first.second;
+        }
+
+        QJsonObject object;
+        object.insert(QStringLiteral("source"), source);
+        object.insert(QStringLiteral("count"), double(entry.second));
+        object.insert(QStringLiteral("perMinute"), perMinute(entry.second, elapsedMs));
+        array.append(object);
+    }
+    return array;
+}
+
+ActivityMonitor::ActivityMonitor(QObject *parent)
+    : QObject(parent)
+{
+    setEnabled(qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_ACTIVITY") > 0);
+}
+
+void ActivityMonitor::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled) {
+        return;
+    }
+
+    m_enabled = enabled;
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance(thread());
+    if (m_enabled) {
+        reset();
+        if (dispatcher) {
+            connect(dispatcher, &QAbstractEventDispatcher::awake, this, &ActivityMonitor::onAwake, Qt::DirectConnection);
+        }
+    } else if (dispatcher) {
+        disconnect(dispatcher, &QAbstractEventDispatcher::awake, this, &ActivityMonitor::onAwake);
+    }
+}
+
+void ActivityMonitor::reset()
+{
+    m_elapsed.start();
+    m_wakeups = 0;
+    m_dbusMessages = 0;
+    m_keyDispatches = 0;
+    m_coalescedRepeats = 0;
+    m_cpuStartNs = processCpuNs();
+    m_frames = 0;
+    m_timers.clear();
+    m_socketNotifiers.clear();
+}
+
+void ActivityMonitor::recordEvent(QObject *receiver, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::Timer: {
+        // Unnamed QTimers are attributed to their owner
+        const char *className = receiver->metaObject()->className();
+        if (qobject_cast<QTimer *>(receiver) && receiver->objectName().isEmpty() && receiver->parent()) {
+            className = receiver->parent()->metaObject()->className();
+        }
+        ++m_timers[qMakePair(className, receiver->objectName())];
+        break;
+    }
+    case QEvent::SockAct: {
+        const QObject *owner = receiver->parent() ? receiver->parent() : receiver;
+        ++m_socketNotifiers[qMakePair(owner->metaObject()->className(), receiver->objectName())];
+        break;
+    }
+    case QEvent::MetaCall:
+        // QtDBus hands incoming signals and method calls over to the GUI thread
+        // as QDBusCallDeliveryEvent, which has no public type to test against
+        if (std::strstr(typeid(*event).name(), "QDBusCallDeliveryEvent")) {
+            ++m_dbusMessages;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void ActivityMonitor::watchView(QQuickView *view)
+{
+    connect(view, &QQuickWindow::frameSwapped, this, [this] {
+        if (m_enabled) {
+            ++m_frames;
+        }
+    }, Qt::DirectConnection);
+
+    // QML timers are driven by the animation timer rather than by timer
+    // events of their own, so count their triggered() signal instead
+    QQuickItem *root = view->rootObject();
+    if (!root) {
+        return;
+    }
+
+    const auto children = root->findChildren<QObject *>();
+    for (QObject *child : children) {
+        if (qstrcmp(child->metaObject()->className(), "QQmlTimer") == 0) {
+            connect(child, SIGNAL(triggered()), this, SLOT(onQmlTimerTriggered()));
+        }
+    }
+}
+
+QString ActivityMonitor::report() const
+{
+    const qint64 elapsedMs = m_enabled ? m_elapsed.elapsed() : 0;
+    const quint64 frames = m_frames;
+
+    QJsonObject counter;
+    QJsonObject root;
+    root.insert(QStringLiteral("enabled"), m_enabled);
+    root.insert(QStringLiteral("elapsedMs"), double(elapsedMs));
+
+    counter.insert(QStringLiteral("count"), double(m_wakeups));
+    counter.insert(QStringLiteral("perMinute"), perMinute(m_wakeups, elapsedMs));
+    root.insert(QStringLiteral("wakeups"), counter);
+
+    counter.insert(QStringLiteral("count"), double(frames));
+    counter.insert(QStringLiteral("perMinute"), perMinute(frames, elapsedMs));
+    root.insert(QStringLiteral("frames"), counter);
+
+    counter.insert(QStringLiteral("count"), double(m_dbusMessages));
+    counter.insert(QStringLiteral("perMinute"), perMinute(m_dbusMessages, elapsedMs));
+    root.insert(QStringLiteral("dbusMessages"), counter);
+
+    counter.insert(QStringLiteral("count"), double(m_keyDispatches));
+    counter.insert(QStringLiteral("perMinute"), perMinute(m_keyDispatches, elapsedMs));
+    root.insert(QStringLiteral("keyDispatches"), counter);
+
+    counter.insert(QStringLiteral("count"), double(m_coalescedRepeats));
+    counter.insert(QStringLiteral("perMinute"), perMinute(m_coalescedRepeats, elapsedMs));
+    root.insert(QStringLiteral("coalescedRepeats"), counter);
+
+    // whole process, render threads included
+    root.insert(QStringLiteral("cpuMs"), m_enabled ? (processCpuNs() - m_cpuStartNs) / 1000000.0 : 0.0);
+
+    root.insert(QStringLiteral("timers"), sourcesToJson(m_timers, elapsedMs));
+    root.insert(QStringLiteral("socketNotifiers"), sourcesToJson(m_socketNotifiers, elapsedMs));
+
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+void ActivityMonitor::onAwake()
+{
+    ++m_wakeups;
+}
+
+void ActivityMonitor::onQmlTimerTriggered()
+{
+    if (m_enabled) {
+        QObject *timer = sender();
+        ++m_timers[qMakePair("QQmlTimer", timer->objectName())];
+    }
+}
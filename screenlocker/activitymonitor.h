@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTIVITYMONITOR_H
+#define ACTIVITYMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+
+#include <atomic>
+
+class QEvent;
+class QQuickView;
+
+// Counts what wakes the locker up while it sits idle: event loop
+// iterations, timer firings by source, rendered frames, incoming
+// D-Bus messages and socket notifier activity. Disabled by default,
+// enable with CUTEFISH_SCREENLOCKER_ACTIVITY=1 or over D-Bus.
+class ActivityMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ActivityMonitor(QObject *parent = nullptr);
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+    void reset();
+
+    // Must only be called from the GUI thread
+    void recordEvent(QObject *receiver, QEvent *event);
+    void watchView(QQuickView *view);
+
+    // Key handling: events dispatched into QML or the password model and
+    // auto-repeats folded into a later dispatch
+    void countKeyDispatch() { if (m_enabled) ++m_keyDispatches; }
+    void countCoalescedRepeat() { if (m_enabled) ++m_coalescedRepeats; }
+
+    QString report() const;
+
+private slots:
+    void onAwake();
+    void onQmlTimerTriggered();
+
+private:
+    typedef QPair<const char *, QString> Source;
+
+    bool m_enabled = false;
+    QElapsedTimer m_elapsed;
+
+    quint64 m_wakeups = 0;
+    quint64 m_dbusMessages = 0;
+    quint64 m_keyDispatches = 0;
+    quint64 m_coalescedRepeats = 0;
+    qint64 m_cpuStartNs = 0;
+    std::atomic<quint64> m_frames { 0 };
+
+    QHash<Source, quint64> m_timers;
+    QHash<Source, quint64> m_socketNotifiers;
+};
+
+#endif // ACTIVITYMONITOR_H
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alloccounter.h"
+
+#include <config-screenlocker.h>
+
+#include <atomic>
+#include <new>
+
+// system
+#include <errno.h>
+#include <stdlib.h>
+
+static std::atomic<int> s_phase { AllocCounter::Idle };
+static std::atomic<quint64> s_counts[AllocCounter::PhaseCount];
+
+static inline void countAllocation()
+{
+    s_counts[s_phase.load(std::memory_order_relaxed)].fetch_add(1, std::memory_order_relaxed);
+}
+
+#if ENABLE_ALLOC_COUNT && defined(__GLIBC__)
+// glibc's own entry points, so no dlsym() is needed, which allocates itself
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (!alignment || alignment % sizeof(void *) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+
+    countAllocation();
+    void *result = __libc_memalign(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *ptr = result;
+    return 0;
+}
+}
+
+// libstdc++'s operator new would go through malloc() too, these only make
+// sure a statically linked one is counted as well
+void *operator new(size_t size)
+{
+    countAllocation();
+    if (void *ptr = __libc_malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// over-aligned types, e.g. alignas(64) members, take these instead
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    countAllocation();
+    if (void *ptr = __libc_memalign(size_t(alignment), size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    countAllocation();
+    return __libc_memalign(size_t(alignment), size ? size : 1);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+#endif
+
+bool AllocCounter::isAvailable()
+{
+#if ENABLE_ALLOC_COUNT && defined(__GLIBC__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocCounter::setPhase(Phase phase)
+{
+    s_phase.store(phase, std::memory_order_relaxed);
+}
+
+quint64 AllocCounter::count(Phase phase)
+{
+    return s_counts[phase].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <QtGlobal>
+
+// Heap allocations per phase of handling an input event, for the replay
+// harness. Builds configured with ENABLE_ALLOC_COUNT interpose malloc,
+// calloc, realloc and the aligned allocators and replace the global
+// operator new, aligned forms included; an allocation on any thread
+// counts against the phase current at that moment. Other builds count
+// nothing and isAvailable() is false.
+class AllocCounter
+{
+public:
+    enum Phase {
+        Idle,
+        // sendEvent() of the input event itself
+        Dispatch,
+        // events it posted, timers that fired right away
+        Posted,
+        // back in the event loop until the next event: polish, sync, render
+        Frame,
+        PhaseCount
+    };
+
+    static bool isAvailable();
+
+    static void setPhase(Phase phase);
+    static quint64 count(Phase phase);
+};
+
+#endif // ALLOCCOUNTER_H
@@ -1,10 +1,35 @@
 #include "application.h"
+#include "activitymonitor.h"
+#include "dbusaudit.h"
+#include "framestats.h"
+#include "frozendesktop.h"
+#include "greeterlink.h"
+#include "iconatlas.h"
+#include "inputgrabber.h"
+#include "pipelinecache.h"
+#include "replayharness.h"
+#include "stallwatchdog.h"
+#include "tracepoints.h"
+#include "userinfo.h"
+#include "wallpaperhandoff.h"
+#include "wallpaperpyramid.h"
 
 // Qt Core
 #include <QAbstractNativeEventFilter>
+#include <QClipboard>
+#include <QDBusConnection>
+#include <QDir>
 #include <QScreen>
 #include <QEvent>
 #include <QFile>
+#include <QFileInfo>
+#include <QInputMethod>
+#include <QKeyEvent>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
 
 // Qt Quick
 #include <QQuickItem>
@@ -12,6 +37,39 @@
 #include <QQmlEngine>
 #include <QQmlProperty>
 
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+#include <rhi/qrhi.h>
+#endif
+
+// system
+#include <time.h>
+
+// Drivers rasterizing on the CPU, where layer effects cost whole frames
+static bool isSoftwareRasterizer(const QByteArray &deviceName)
+{
+    const QByteArray name = deviceName.toLower();
+    return name.contains("llvmpipe") || name.contains("softpipe") || name.contains("swiftshader");
+}
+
+// Present while the last lock found a software rasterizer
+static QString softwareRendererMarker()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + QStringLiteral("/cutefish-screenlocker/software-renderer");
+}
+
+// A character or Backspace, which go to the password model
+static bool isTypedKey(const QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Backspace) {
+        return true;
+    }
+
+    // text() is shared with the event, no copy is made
+    const QString text = event->text();
+    return !text.isEmpty() && text.at(0).isPrint();
+}
+
 // this is usable to fake a "screensaver" installation for testing
 // *must* be "0" for every public commit!
 #define TEST_SCREENSAVER 0
@@ -34,8 +92,49 @@ public:
 
 Application::Application(int &argc, char **argv)
     : QGuiApplication(argc, argv)
+    , m_activityMonitor(new ActivityMonitor(this))
     , m_authenticator(new Authenticator(AuthenticationMode::Direct, this))
+    , m_frameStats(new FrameStats(this))
+    , m_watchdog(new StallWatchdog(this))
+    , m_grabber(new InputGrabber(this))
+    , m_repeatTimer(new QTimer(this))
+    , m_userInfo(new UserInfo(this))
+    , m_wallpaper(new WallpaperPyramid(this))
+    , m_wallpaperHandoff(new WallpaperHandoff(m_wallpaper, this))
+    , m_frozenDesktop(new FrozenDesktop(this))
 {
+    m_startClock.start();
+    m_watchdog->attach();
+
+    // The lite scene has a pre-blurred background and no layer effects, so
+    // the software backend only repaints what changed. It is picked for the
+    // software backend and remembered for CPU rasterizers behind the RHI,
+    // which only show once a scene graph is up.
+    const QByteArray lite = qgetenv("CUTEFISH_SCREENLOCKER_LITE");
+    m_liteForced = !lite.isEmpty();
+    m_liteScene = m_liteForced ? lite != "0"
+                               : QQuickWindow::sceneGraphBackend() == QLatin1String("software")
+                                 || QQuickWindow::graphicsApi() == QSGRendererInterface::Software
+                                 || QFile::exists(softwareRendererMarker());
+
+    // one password update per frame for key repeat bursts
+    m_repeatTimer->setObjectName(QStringLiteral("keyRepeatTimer"));
+    m_repeatTimer->setSingleShot(true);
+    m_repeatTimer->setInterval(16);
+    connect(m_repeatTimer, &QTimer::timeout, this, &Application::flushRepeat);
+
+    connect(m_grabber, &InputGrabber::secured, this, [this](qint64 elapsedNs) {
+        m_inputSecuredNs = elapsedNs;
+        qInfo().nospace() << "Input secured after " << elapsedNs / 1000000.0 << " ms, " << m_grabber->attempts() << " attempts";
+        Q_EMIT inputSecured(elapsedNs / 1000000.0);
+    });
+    connect(m_grabber, &InputGrabber::failed, this, &Application::grabFailed);
+
+    const QString recordFile = qEnvironmentVariable("CUTEFISH_SCREENLOCKER_RECORD");
+    if (!recordFile.isEmpty()) {
+        m_recorder = new EventRecorder(recordFile, this);
+    }
+
     // It's a queued connection to give the QML part time to eventually execute code connected to Authenticator::succeeded if any
     connect(m_authenticator, &Authenticator::succeeded, this, &Application::onSucceeded, Qt::QueuedConnection);
 
@@ -53,6 +152,8 @@ Application::Application(int &argc, char **argv)
 
 Application::~Application()
 {
+    m_frameStats->dump();
+
     // workaround QTBUG-55460
     // will be fixed when themes port to QQC2
     for (auto view : std::as_const(m_views)) {
@@ -63,8 +164,31 @@ Application::~Application()
     qDeleteAll(m_views);
 }
 
+bool Application::notify(QObject *receiver, QEvent *event)
+{
+    if (m_activityMonitor && m_activityMonitor->isEnabled() && QThread::currentThread() == thread()) {
+        m_activityMonitor->recordEvent(receiver, event);
+    }
+
+    return QGuiApplication::notify(receiver, event);
+}
+
 void Application::initialViewSetup()
 {
+    m_userInfo->prefetch();
+
+    // translations are installed by now, the views are not created yet
+    m_textWarmup.start(TextWarmup::lockScreenText(m_userInfo->userName()));
+
+    // the split lock holder has already covered the desktop by now
+    if (FrozenDesktop::isRequested() && !m_holderLink && !m_testing) {
+        QList<QRect> geometries;
+        for (int i = 0; i < screenCount(); ++i) {
+            geometries << nativeScreenGeometry(i);
+        }
+        m_frozenDesktop->capture(geometries);
+    }
+
     for (QScreen *screen : screens()) {
         connect(screen, &QScreen::geometryChanged, this, [this, screen](const QRect &geo) {
             screenGeometryChanged(screen, geo);
@@ -74,30 +198,80 @@ void Application::initialViewSetup()
     desktopResized();
 }
 
+void Application::prepareEngine(QQmlEngine *engine, QQuickWindow *view, int index)
+{
+    QQmlContext *context = engine->rootContext();
+    context->setContextProperty(QStringLiteral("authenticator"), m_authenticator);
+    context->setContextProperty(QStringLiteral("frameStats"), m_frameStats->addView(view));
+    applyScene(context);
+    context->setContextProperty(QStringLiteral("userInfo"), m_userInfo);
+    context->setContextProperty(QStringLiteral("wallpaperPyramid"), m_wallpaper);
+    engine->addImageProvider(QStringLiteral("useravatar"), new UserAvatarProvider(m_userInfo));
+    engine->addImageProvider(QStringLiteral("icons"), new IconAtlasProvider);
+    engine->addImageProvider(QStringLiteral("wallpaper"), new WallpaperProvider(m_wallpaper));
+    engine->addImageProvider(QStringLiteral("desktop"), new FrozenDesktopProvider(m_frozenDesktop));
+
+    const int desktopIndex = m_frozenDesktop->indexOf(nativeScreenGeometry(index));
+    context->setContextProperty(QStringLiteral("desktopBackground"),
+                                desktopIndex >= 0 ? QStringLiteral("image://desktop/%1").arg(desktopIndex) : QString());
+}
+
+void Application::setHolderLink(int fd, bool standby)
+{
+    m_standby = standby;
+    m_holderLink = new GreeterLink(fd, this);
+    connect(m_holderLink, &GreeterLink::messageReceived, this, &Application::onHolderMessage);
+    connect(m_holderLink, &GreeterLink::inputReceived, this, &Application::onHolderInput);
+    connect(m_holderLink, &GreeterLink::disconnected, this, &Application::onHolderDisconnected);
+
+    m_holderLink->send("service " + QDBusConnection::sessionBus().baseService().toLatin1());
+}
+
 void Application::desktopResized()
 {
-    const int nScreens = screens().count();
+    StallWatchdog::Operation operation("Application::desktopResized");
+
+    const int nScreens = screenCount();
+
+    if (m_recorder) {
+        QList<QRect> geometries;
+        for (int i = 0; i < nScreens; ++i) {
+            geometries << screenGeometry(i);
+        }
+        m_recorder->recordScreens(geometries);
+    }
+
     // remove useless views and savers
     while (m_views.count() > nScreens) {
-        m_views.takeLast()->deleteLater();
+        QQuickView *view = m_views.takeLast();
+        m_presentedViews.remove(view);
+        view->deleteLater();
     }
 
     // extend views and savers to current demand
     for (int i = m_views.count(); i < nScreens; ++i) {
+        // before the view asks for the wallpaper, in device pixels like its sourceSize
+        m_wallpaperHandoff->request(screenGeometry(i).size() * screenAt(i)->devicePixelRatio());
+
         // create the view
         auto *view = new QQuickView;
+        if (!m_testing) {
+            // before the scene graph comes up on first expose
+            PipelineCache::configure(view, i);
+            if (m_firstFrameNs < 0 && !PipelineCache::isWarm(i)) {
+                m_coldPipelineCaches++;
+            }
+        }
         view->create();
 
         // engine stuff
-        QQmlContext *context = view->engine()->rootContext();
-        context->setContextProperty(QStringLiteral("authenticator"), m_authenticator);
+        prepareEngine(view->engine(), view, i);
 
         view->setSource(QUrl("qrc:/qml/LockScreen.qml"));
         view->setResizeMode(QQuickView::SizeRootObjectToView);
 
         view->setColor(Qt::black);
-        auto screen = QGuiApplication::screens()[i];
-        view->setGeometry(screen->geometry());
+        view->setGeometry(screenGeometry(i));
 
         if (!m_testing) {
             // 统一使用FramelessWindowHint
@@ -110,18 +284,38 @@ void Application::desktopResized()
         // delete oldFactory;
         // view->engine()->setNetworkAccessManagerFactory(new NoAccessNetworkAccessManagerFactory);
 
-        view->setGeometry(screen->geometry());
+        view->setGeometry(screenGeometry(i));
+
+        m_activityMonitor->watchView(view);
 
         connect(view, &QQuickView::frameSwapped, this, [=] { markViewsAsVisible(view); }, Qt::QueuedConnection);
+        connect(view, &QQuickWindow::activeFocusItemChanged, this, [=] { onActiveFocusItemChanged(view); });
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        // on the render thread; the software backend has no RHI and is known already
+        connect(view, &QQuickWindow::sceneGraphInitialized, this, [this, view] {
+            if (QRhi *rhi = view->rhi()) {
+                const bool software = isSoftwareRasterizer(rhi->driverInfo().deviceName);
+                QMetaObject::invokeMethod(this, [this, software] { setLiteScene(software); }, Qt::QueuedConnection);
+            }
+        }, Qt::DirectConnection);
+#endif
 
         m_views << view;
     }
 
+    // a standby greeter keeps its views loaded but hidden until the holder needs it
+    if (m_standby) {
+        return;
+    }
+
     // update geometry of all views and savers
     for (int i = 0; i < nScreens; ++i) {
         auto *view = m_views.at(i);
-        auto screen = QGuiApplication::screens()[i];
-        view->setScreen(screen);
+        view->setScreen(screenAt(i));
+        if (!m_fakeScreens.isEmpty()) {
+            view->setGeometry(screenGeometry(i));
+        }
 
         // 简化窗口显示逻辑
         if (m_testing) {
@@ -134,6 +328,44 @@ void Application::desktopResized()
     }
 }
 
+void Application::setFakeScreens(const QList<QRect> &geometries)
+{
+    m_fakeScreens = geometries;
+    desktopResized();
+}
+
+void Application::setFakeScreenGeometry(int index, const QRect &geometry)
+{
+    if (index >= 0 && index < m_fakeScreens.count()) {
+        m_fakeScreens[index] = geometry;
+    }
+
+    viewGeometryChanged(index, geometry);
+}
+
+int Application::screenCount() const
+{
+    return m_fakeScreens.isEmpty() ? screens().count() : m_fakeScreens.count();
+}
+
+QScreen *Application::screenAt(int index) const
+{
+    // every fake screen lives on the one offscreen screen
+    return m_fakeScreens.isEmpty() ? screens().at(index) : primaryScreen();
+}
+
+QRect Application::screenGeometry(int index) const
+{
+    return m_fakeScreens.isEmpty() ? screens().at(index)->geometry() : m_fakeScreens.at(index);
+}
+
+QRect Application::nativeScreenGeometry(int index) const
+{
+    // Qt scales the size of a screen but keeps its native position
+    const QRect geometry = screenGeometry(index);
+    return QRect(geometry.topLeft(), geometry.size() * screenAt(index)->devicePixelRatio());
+}
+
 void Application::onScreenAdded(QScreen *screen)
 {
     // Lambda connections can not have uniqueness constraints, ensure
@@ -145,8 +377,103 @@ void Application::onScreenAdded(QScreen *screen)
     desktopResized();
 }
 
+void Application::setActivityMonitorEnabled(bool enabled)
+{
+    m_activityMonitor->setEnabled(enabled);
+}
+
+void Application::resetActivityMonitor()
+{
+    m_activityMonitor->reset();
+}
+
+QString Application::activityReport() const
+{
+    return m_activityMonitor->report();
+}
+
+void Application::setFrameStatsEnabled(bool enabled)
+{
+    m_frameStats->setEnabled(enabled);
+}
+
+QString Application::frameStatsReport() const
+{
+    return m_frameStats->report();
+}
+
+void Application::setLiteScene(bool lite)
+{
+    if (m_liteForced || lite == m_liteScene) {
+        return;
+    }
+    m_liteScene = lite;
+
+    // so the next lock starts with the right scene, and a GPU showing up clears it
+    const QString marker = softwareRendererMarker();
+    if (lite) {
+        QDir().mkpath(QFileInfo(marker).absolutePath());
+        QFile(marker).open(QIODevice::WriteOnly);
+    } else {
+        QFile::remove(marker);
+    }
+
+    for (QQuickView *view : std::as_const(m_views)) {
+        applyScene(view->engine()->rootContext());
+    }
+}
+
+void Application::applyScene(QQmlContext *context)
+{
+    context->setContextProperty(QStringLiteral("liteScene"), m_liteScene);
+
+    if (auto *recorder = qobject_cast<FrameRecorder *>(context->contextProperty(QStringLiteral("frameStats")).value<QObject *>())) {
+        recorder->setScene(m_liteScene ? QStringLiteral("lite") : QStringLiteral("full"));
+    }
+}
+
+QString Application::iconAtlasReport() const
+{
+    return IconAtlas::self()->report();
+}
+
+QString Application::wallpaperReport() const
+{
+    return m_wallpaper->report();
+}
+
+QString Application::blockingCallReport() const
+{
+    return DBusAudit::instance()->report();
+}
+
+QString Application::startupReport() const
+{
+    QJsonObject report;
+    report[QStringLiteral("firstFrameMs")] = m_firstFrameNs < 0 ? -1.0 : m_firstFrameNs / 1000000.0;
+    report[QStringLiteral("pipelineCache")] = m_testing ? QStringLiteral("off")
+                                              : m_coldPipelineCaches ? QStringLiteral("cold") : QStringLiteral("warm");
+    report[QStringLiteral("pipelineCacheDir")] = PipelineCache::location();
+    const qint64 textNs = m_textWarmup.elapsedNs();
+    report[QStringLiteral("textWarmupMs")] = textNs < 0 ? -1.0 : textNs / 1000000.0;
+    return QString::fromUtf8(QJsonDocument(report).toJson(QJsonDocument::Compact));
+}
+
+double Application::inputSecuredTime() const
+{
+    return m_inputSecuredNs < 0 ? -1.0 : m_inputSecuredNs / 1000000.0;
+}
+
+bool Application::isLockActive() const
+{
+    return m_lockActive;
+}
+
 void Application::onSucceeded()
 {
+    // let the desktop resume before the unlock animation reveals it
+    setLockActive(false);
+
     QQuickView *mainView = nullptr;
 
     // 寻找主屏幕的 view
@@ -157,6 +484,8 @@ void Application::onSucceeded()
         }
     }
 
+    LOCKER_TRACE(unlock_animation_begin);
+
     if (mainView) {
         QVariantAnimation *ani = new QVariantAnimation;
 
@@ -165,6 +494,10 @@ void Application::onSucceeded()
         });
 
         connect(ani, &QVariantAnimation::finished, this, [=] {
+            LOCKER_TRACE(unlock_animation_end);
+            if (m_holderLink) {
+                m_holderLink->send("unlocked");
+            }
             QCoreApplication::exit();
         });
 
@@ -174,30 +507,28 @@ void Application::onSucceeded()
         ani->setEndValue(mainView->geometry().y() + -mainView->geometry().height());
         ani->start();
     } else {
+        if (m_holderLink) {
+            m_holderLink->send("unlocked");
+        }
         QCoreApplication::exit();
     }
 }
 
 void Application::getFocus()
 {
+    StallWatchdog::Operation operation("Application::getFocus");
+
     QWindow *activeScreen = getActiveScreen();
 
     if (!activeScreen) {
         return;
     }
 
-    // this loop is required to make the qml/graphicsscene properly handle the shared keyboard input
-    // ie. "type something into the box of every greeter"
-    for (QQuickView *view : std::as_const(m_views)) {
-        if (!m_testing) {
-            view->setKeyboardGrabEnabled(true);
-        }
-    }
-
-    // activate window and grab input to be sure it really ends up there.
+    // activate window and grab input to be sure it really ends up there, retried
+    // until no other client holds a grab. All views show the one password model.
     // focus setting is still required for proper internal QWidget state (and eg. visual reflection)
     if (!m_testing) {
-        activeScreen->setKeyboardGrabEnabled(true);
+        m_grabber->grab(activeScreen);
     }
 
     activeScreen->requestActivate();
@@ -209,6 +540,30 @@ void Application::markViewsAsVisible(QQuickView *view)
     QQmlProperty showProperty(view->rootObject(), QStringLiteral("viewVisible"));
     showProperty.write(true);
 
+    m_presentedViews.insert(view);
+    if (m_presentedViews.count() == m_views.count()) {
+        DBusAudit::instance()->setCriticalPathDone();
+
+        if (m_firstFrameNs < 0) {
+            m_firstFrameNs = m_startClock.nsecsElapsed();
+            const bool warm = !m_testing && m_coldPipelineCaches == 0;
+            qInfo().nospace() << "First frame on all screens after " << m_firstFrameNs / 1000000.0 << " ms, "
+                              << (warm ? "warm" : "cold") << " pipeline cache";
+            LOCKER_TRACE2(first_frame, m_firstFrameNs / 1000, warm);
+        }
+        setLockActive(true);
+
+        if (m_holderLink && !m_readySent) {
+            m_readySent = true;
+            m_holderLink->send("ready");
+        }
+    }
+
+    // the holder keeps the grab until we are on screen
+    if (m_holderLink && !m_holderReleasedGrab) {
+        return;
+    }
+
     // random state update, actually rather required on init only
     QMetaObject::invokeMethod(this, "getFocus", Qt::QueuedConnection);
 }
@@ -236,6 +591,12 @@ bool Application::eventFilter(QObject *obj, QEvent *event)
         return false;
     }
 
+    if (m_recorder) {
+        if (auto *view = qobject_cast<QQuickView *>(obj)) {
+            m_recorder->recordEvent(m_views.indexOf(view), event);
+        }
+    }
+
     if (event->type() == QEvent::MouseButtonPress) {
         if (getActiveScreen()) {
             getActiveScreen()->requestActivate();
@@ -243,15 +604,48 @@ bool Application::eventFilter(QObject *obj, QEvent *event)
         return false;
     }
 
+    if (!m_inputLive && (event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease)) {
+        auto *view = qobject_cast<QQuickView *>(obj);
+        if (view && m_views.contains(view)) {
+            // the password field is not there yet, keep the key for it
+            if (event->type() == QEvent::KeyPress) {
+                LOCKER_TRACE(early_key_press);
+                m_earlyInput.addKey(static_cast<QKeyEvent *>(event));
+            }
+            return true;
+        }
+    }
+
+    // dead keys, compose and input methods commit their text to the field itself
+    if (event->type() == QEvent::InputMethod) {
+        return commitPassword(obj, static_cast<QInputMethodEvent *>(event));
+    }
+
+    // Typed text goes to the password model, which every view shows
+    auto *view = qobject_cast<QQuickView *>(obj);
+    if (!view || !m_views.contains(view)) {
+        return false;
+    }
+
     // 修复事件类型检查 - 使用QEvent枚举值而不是宏
     if (event->type() == QEvent::Type::KeyPress) { // react if saver is visible
-        shareEvent(event, qobject_cast<QQuickView *>(obj));
-        return false; // we don't care
+        QKeyEvent *ke = static_cast<QKeyEvent *>(event);
+        LOCKER_TRACE(key_press);
+        m_frameStats->markInput();
+
+        if (ke->isAutoRepeat() && coalesceRepeat(view, ke)) {
+            return true;
+        }
+        // keep the order with a burst still waiting for its frame
+        flushRepeat();
+
+        m_activityMonitor->countKeyDispatch();
+        return editPassword(view, ke);
     } else if (event->type() == QEvent::Type::KeyRelease) { // conditionally reshow the saver
         QKeyEvent *ke = static_cast<QKeyEvent *>(event);
         if (ke->key() != Qt::Key_Escape) {
-            shareEvent(event, qobject_cast<QQuickView *>(obj));
-            return false; // irrelevant
+            // releases of a repeat burst and of typed text carry nothing for the text field
+            return ke->isAutoRepeat() || (isTypedKey(ke) && isPasswordFocused(view));
         }
         return true; // don't pass
     }
@@ -280,39 +674,31 @@ QWindow *Application::getActiveScreen()
     return activeScreen;
 }
 
-void Application::shareEvent(QEvent *e, QQuickView *from)
-{
-    // from can be NULL any time (because the parameter is passed as qobject_cast)
-    // m_views.contains(from) is atm. supposed to be true but required if any further
-    // QQuickView are added (which are not part of m_views)
-    // this makes "from" an optimization (nullptr check aversion)
-    if (from && m_views.contains(from)) {
-        // NOTICE any recursion in the event sharing will prevent authentication on multiscreen setups!
-        // Any change in regarded event processing shall be tested thoroughly!
-        removeEventFilter(this); // prevent recursion!
-        const bool accepted = e->isAccepted(); // store state
-        for (QQuickView *view : std::as_const(m_views)) {
-            if (view != from) {
-                QCoreApplication::sendEvent(view, e);
-                e->setAccepted(accepted);
-            }
-        }
-        installEventFilter(this);
-    }
-}
-
 void Application::screenGeometryChanged(QScreen *screen, const QRect &geo)
 {
     // We map screens() to m_views by index and Qt is free to
     // reorder screens, so pointer to pointer connections
     // may not remain matched by index, perform index
     // mapping in the change event itself
+    if (!m_fakeScreens.isEmpty()) {
+        return;
+    }
+
     const int screenIndex = QGuiApplication::screens().indexOf(screen);
     if (screenIndex < 0) {
         qWarning() << "Screen not found, not updating geometry" << screen;
         return;
     }
 
+    viewGeometryChanged(screenIndex, geo);
+}
+
+void Application::viewGeometryChanged(int screenIndex, const QRect &geo)
+{
+    if (m_recorder) {
+        m_recorder->recordGeometry(screenIndex, geo);
+    }
+
     if (screenIndex >= m_views.size()) {
         qWarning() << "Screen index out of range, not updating geometry" << screenIndex;
         return;
@@ -320,4 +706,222 @@ void Application::screenGeometryChanged(QScreen *screen, const QRect &geo)
 
     QQuickView *view = m_views[screenIndex];
     view->setGeometry(geo);
-}
\ No newline at end of file
+}
+
+void Application::setLockActive(bool active)
+{
+    if (m_lockActive == active) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    m_lockActive = active;
+    LOCKER_TRACE1(lock_active, int(active));
+
+    // in --split mode the lock holder announces it, once for all greeters
+    if (m_holderLink) {
+        return;
+    }
+    Q_EMIT lockActiveChanged(active, qlonglong(now.tv_sec) * 1000000 + now.tv_nsec / 1000);
+}
+
+bool Application::coalesceRepeat(QQuickView *view, QKeyEvent *event)
+{
+    if (!isPasswordFocused(view)) {
+        return false;
+    }
+
+    if (!isTypedKey(event)) {
+        return false;
+    }
+
+    if (m_repeat.count && (m_repeat.view != view || m_repeat.key != event->key())) {
+        flushRepeat();
+    }
+
+    m_repeat.view = view;
+    m_repeat.key = event->key();
+    m_repeat.text = event->text();
+    ++m_repeat.count;
+    m_activityMonitor->countCoalescedRepeat();
+
+    if (!m_repeatTimer->isActive()) {
+        m_repeatTimer->start();
+    }
+    return true;
+}
+
+void Application::flushRepeat()
+{
+    m_repeatTimer->stop();
+    if (!m_repeat.count) {
+        return;
+    }
+
+    // the password field is disabled while grace locked
+    if (m_repeat.view && !m_authenticator->isGraceLocked()) {
+        PasswordModel *password = m_authenticator->password();
+        if (m_repeat.key == Qt::Key_Backspace) {
+            password->backspace(m_repeat.count);
+        } else {
+            password->insert(m_repeat.text, m_repeat.count);
+        }
+        m_activityMonitor->countKeyDispatch();
+    }
+
+    // wiping a copy still shared with the event would detach it, and allocate
+    if (m_repeat.text.isDetached()) {
+        m_repeat.text.fill(QChar(0));
+    }
+    m_repeat = KeyRepeat();
+}
+
+bool Application::editPassword(QQuickView *view, QKeyEvent *event)
+{
+    if (!isPasswordFocused(view)) {
+        return false;
+    }
+
+    // matches() looks up the platform key bindings, which allocates
+    PasswordModel *password = m_authenticator->password();
+    if (event->key() == Qt::Key_A && event->matches(QKeySequence::SelectAll)) {
+        password->selectAll();
+        return true;
+    }
+
+    // Ctrl+V and Shift+Insert, the field itself cannot paste while read only
+    if ((event->key() == Qt::Key_V || event->key() == Qt::Key_Insert) && event->matches(QKeySequence::Paste)) {
+        if (!m_authenticator->isGraceLocked()) {
+            pastePassword();
+        }
+        return true;
+    }
+
+    // Return and Escape are handled in QML
+    if (!isTypedKey(event)) {
+        return false;
+    }
+
+    if (!m_authenticator->isGraceLocked()) {
+        if (event->key() == Qt::Key_Backspace) {
+            password->backspace();
+        } else {
+            password->insert(event->text());
+        }
+    }
+    return true;
+}
+
+bool Application::commitPassword(QObject *obj, QInputMethodEvent *event)
+{
+    auto *item = qobject_cast<QQuickItem *>(obj);
+    if (!item || item->objectName() != QLatin1String("passwordField") || !m_views.contains(qobject_cast<QQuickView *>(item->window()))) {
+        return false;
+    }
+
+    // the preedit is never shown, only committed text reaches the password
+    if (!event->commitString().isEmpty() && !m_authenticator->isGraceLocked()) {
+        m_frameStats->markInput();
+        flushRepeat();
+        m_authenticator->password()->insert(event->commitString());
+    }
+    return true;
+}
+
+void Application::pastePassword()
+{
+    QString text = clipboard()->text();
+
+    // a copied line often ends in a line break, which would not be typed
+    qsizetype length = 0;
+    while (length < text.size() && text.at(length) != QLatin1Char('\n') && text.at(length) != QLatin1Char('\r')) {
+        ++length;
+    }
+    if (length) {
+        flushRepeat();
+        m_authenticator->password()->insert(QStringView(text).left(length));
+    }
+
+    // our copy of the clipboard, the clipboard itself is left alone
+    text.fill(QChar(0));
+}
+
+bool Application::isPasswordFocused(QQuickView *view) const
+{
+    const QQuickItem *item = view->activeFocusItem();
+    return item && item->objectName() == QLatin1String("passwordField");
+}
+
+void Application::onActiveFocusItemChanged(QQuickView *view)
+{
+    if (!isPasswordFocused(view)) {
+        return;
+    }
+
+    // read only turns the input method off, composed text must still come in
+    view->activeFocusItem()->setFlag(QQuickItem::ItemAcceptsInputMethod);
+    QGuiApplication::inputMethod()->update(Qt::ImEnabled | Qt::ImHints);
+
+    if (m_inputLive) {
+        return;
+    }
+
+    m_inputLive = true;
+    QMetaObject::invokeMethod(this, &Application::flushEarlyInput, Qt::QueuedConnection);
+}
+
+void Application::flushEarlyInput()
+{
+    if (m_earlyInput.isEmpty()) {
+        return;
+    }
+
+    if (!m_earlyInput.text().isEmpty()) {
+        m_authenticator->password()->insert(m_earlyInput.text());
+    }
+
+    // submit once, every view shares the one authenticator
+    if (m_earlyInput.submit() && !m_views.isEmpty() && m_views.first()->rootObject()) {
+        QMetaObject::invokeMethod(m_views.first()->rootObject(), "tryUnlock");
+    }
+
+    m_earlyInput.clear();
+}
+
+void Application::onHolderMessage(const QByteArray &message)
+{
+    if (message == "show" && m_standby) {
+        m_standby = false;
+        desktopResized();
+    } else if (message == "submit") {
+        m_earlyInput.setSubmit();
+        if (m_inputLive) {
+            flushEarlyInput();
+        }
+    } else if (message == "grab") {
+        m_holderReleasedGrab = true;
+        getFocus();
+    }
+}
+
+void Application::onHolderInput(const SecureBuffer &text)
+{
+    // typed on the holder's covers before we were shown
+    m_earlyInput.appendUtf8(text.constData(), text.size());
+    if (m_inputLive) {
+        flushEarlyInput();
+    }
+}
+
+void Application::onHolderDisconnected()
+{
+    if (m_standby) {
+        // nobody is going to show us anymore
+        QCoreApplication::exit(1);
+        return;
+    }
+
+    qWarning() << "Lock holder went away, keeping the greeter up";
+}
@@ -23,12 +23,32 @@
 #include <QGuiApplication>
 #include <QQuickView>
 
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QSet>
 #include <QVariantAnimation>
 #include "authenticator.h"
+#include "earlyinput.h"
+#include "textwarmup.h"
+
+class ActivityMonitor;
+class EventRecorder;
+class FrameStats;
+class FrozenDesktop;
+class GreeterLink;
+class InputGrabber;
+class QInputMethodEvent;
+class QQmlContext;
+class QTimer;
+class StallWatchdog;
+class UserInfo;
+class WallpaperHandoff;
+class WallpaperPyramid;
 
 class Application : public QGuiApplication
 {
     Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.cutefish.ScreenLocker")
 
 public:
     explicit Application(int &argc, char **argv);
@@ -36,10 +56,46 @@ public:
 
     void initialViewSetup();
 
+    // Run as the greeter of a separate lock holder process (--split)
+    void setHolderLink(int fd, bool standby);
+
+    // Replay harness: stand-ins for the real screens on the offscreen platform
+    void setTesting(bool testing) { m_testing = testing; }
+    void setFakeScreens(const QList<QRect> &geometries);
+    void setFakeScreenGeometry(int index, const QRect &geometry);
+    QList<QQuickView *> views() const { return m_views; }
+    Authenticator *authenticator() const { return m_authenticator; }
+    GreeterLink *holderLink() const { return m_holderLink; }
+
+    // Context properties and image providers for the lock screen of one screen
+    void prepareEngine(QQmlEngine *engine, QQuickWindow *view, int index);
+
+    bool notify(QObject *receiver, QEvent *event) override;
+
 public slots:
     void desktopResized();
     void onScreenAdded(QScreen *screen);
 
+    // D-Bus
+    Q_SCRIPTABLE void setActivityMonitorEnabled(bool enabled);
+    Q_SCRIPTABLE void resetActivityMonitor();
+    Q_SCRIPTABLE QString activityReport() const;
+    Q_SCRIPTABLE void setFrameStatsEnabled(bool enabled);
+    Q_SCRIPTABLE QString frameStatsReport() const;
+    Q_SCRIPTABLE QString blockingCallReport() const;
+    Q_SCRIPTABLE bool isLockActive() const;
+    Q_SCRIPTABLE double inputSecuredTime() const;
+    Q_SCRIPTABLE QString iconAtlasReport() const;
+    Q_SCRIPTABLE QString wallpaperReport() const;
+    Q_SCRIPTABLE QString startupReport() const;
+
+signals:
+    // timestamp is CLOCK_MONOTONIC in microseconds
+    Q_SCRIPTABLE void lockActiveChanged(bool active, qlonglong timestamp);
+    // ms from the start of the locker until keyboard and pointer were grabbed
+    Q_SCRIPTABLE void inputSecured(double ms);
+    Q_SCRIPTABLE void grabFailed(const QString &reason);
+
 private slots:
     void onSucceeded();
     void getFocus();
@@ -50,14 +106,73 @@ protected:
 
 private:
     QWindow *getActiveScreen();
-    void shareEvent(QEvent *e, QQuickView *from);
+    bool coalesceRepeat(QQuickView *view, QKeyEvent *event);
+    void flushRepeat();
+    bool editPassword(QQuickView *view, QKeyEvent *event);
+    bool commitPassword(QObject *obj, QInputMethodEvent *event);
+    void pastePassword();
+    bool isPasswordFocused(QQuickView *view) const;
     void screenGeometryChanged(QScreen *screen, const QRect &geo);
+    void viewGeometryChanged(int screenIndex, const QRect &geo);
+    int screenCount() const;
+    QScreen *screenAt(int index) const;
+    QRect screenGeometry(int index) const;
+    QRect nativeScreenGeometry(int index) const;
+    void onHolderMessage(const QByteArray &message);
+    void onHolderInput(const SecureBuffer &text);
+    void onHolderDisconnected();
+    void setLockActive(bool active);
+    void setLiteScene(bool lite);
+    void applyScene(QQmlContext *context);
+    void onActiveFocusItemChanged(QQuickView *view);
+    void flushEarlyInput();
 
 private:
+    // Created first, notify() already runs while the other members are set up
+    ActivityMonitor *m_activityMonitor = nullptr;
     Authenticator *m_authenticator;
+    FrameStats *m_frameStats;
+    StallWatchdog *m_watchdog;
+    InputGrabber *m_grabber;
+    QTimer *m_repeatTimer;
+    qint64 m_inputSecuredNs = -1;
+    QElapsedTimer m_startClock;
+    qint64 m_firstFrameNs = -1;
+    int m_coldPipelineCaches = 0;
+    TextWarmup m_textWarmup;
+    UserInfo *m_userInfo;
+    WallpaperPyramid *m_wallpaper;
+    WallpaperHandoff *m_wallpaperHandoff;
+    FrozenDesktop *m_frozenDesktop;
     QList<QQuickView *> m_views;
+    QSet<QQuickView *> m_presentedViews;
+    QList<QRect> m_fakeScreens;
+    EventRecorder *m_recorder = nullptr;
+
+    GreeterLink *m_holderLink = nullptr;
+    bool m_standby = false;
+    bool m_holderReleasedGrab = false;
+    bool m_readySent = false;
+    bool m_lockActive = false;
+
+    // Auto-repeat burst waiting for the next frame
+    struct KeyRepeat {
+        QPointer<QQuickView> view;
+        int key = 0;
+        QString text;
+        int count = 0;
+    };
+    KeyRepeat m_repeat;
+
+    // Keys typed before the password field has focus, replayed into it once it does
+    EarlyInput m_earlyInput;
+    bool m_inputLive = false;
 
     bool m_testing = false;
+
+    // Software rendering, see the constructor
+    bool m_liteScene = false;
+    bool m_liteForced = false;
 };
 
 #endif // APPLICATION_H
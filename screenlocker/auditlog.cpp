@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "auditlog.h"
+
+#include <chrono>
+#include <thread>
+
+// system
+#include <syslog.h>
+
+static qint64 sinceUs(qint64 fromNs, qint64 toNs)
+{
+    return fromNs && toNs ? (toNs - fromNs) / 1000 : -1;
+}
+
+AuditLog *AuditLog::self()
+{
+    // never destroyed, the writer may still be in syslog() at exit
+    static AuditLog *log = new AuditLog;
+    return log;
+}
+
+qint64 AuditLog::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AuditLog::AuditLog()
+{
+    // does not connect yet, the writer does on its first record
+    openlog("cutefish-screenlocker", LOG_PID, LOG_AUTH);
+
+    std::thread(&AuditLog::run, this).detach();
+}
+
+void AuditLog::submit(const Attempt &attempt)
+{
+    const unsigned head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= s_ringSize) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Slot &slot = m_ring[head % s_ringSize];
+    slot.attempt = attempt;
+    slot.droppedBefore = m_dropped.exchange(0, std::memory_order_relaxed);
+    m_head.store(head + 1);
+
+    // the mutex is only ever held by a writer about to sleep
+    if (m_idleWaiting) {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_condition.notify_one();
+    }
+}
+
+void AuditLog::flush(int timeoutMs)
+{
+    const qint64 deadline = now() + qint64(timeoutMs) * 1000000;
+    while (m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed) && now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void AuditLog::run()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            m_idleWaiting = true;
+            m_condition.wait(locker, [this] {
+                return m_tail.load() != m_head.load();
+            });
+            m_idleWaiting = false;
+        }
+
+        const unsigned tail = m_tail.load(std::memory_order_relaxed);
+        write(m_ring[tail % s_ringSize]);
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+void AuditLog::write(const Slot &slot)
+{
+    const Attempt &attempt = slot.attempt;
+
+    if (attempt.helper == Helper::None) {
+        syslog(LOG_INFO,
+               "attempt=%d helper=none result=%s total_us=%lld dropped=%u",
+               attempt.id,
+               attempt.result,
+               static_cast<long long>(sinceUs(attempt.requestedNs, attempt.resultNs)),
+               slot.droppedBefore);
+        return;
+    }
+
+    const bool preforked = attempt.helper == Helper::Preforked;
+    const qint64 askedFromNs = preforked ? attempt.requestedNs : attempt.helperReadyNs;
+
+    syslog(LOG_INFO,
+           "attempt=%d helper=%s result=%s spawn_us=%lld prompt_us=%lld verify_us=%lld total_us=%lld dropped=%u",
+           attempt.id,
+           preforked ? "preforked" : "direct",
+           attempt.result,
+           static_cast<long long>(preforked ? 0 : sinceUs(attempt.requestedNs, attempt.helperReadyNs)),
+           static_cast<long long>(sinceUs(askedFromNs, attempt.passwordSentNs)),
+           static_cast<long long>(sinceUs(attempt.passwordSentNs, attempt.resultNs)),
+           static_cast<long long>(sinceUs(attempt.requestedNs, attempt.resultNs)),
+           slot.droppedBefore);
+}
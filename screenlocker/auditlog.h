@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef AUDITLOG_H
+#define AUDITLOG_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Structured record of every unlock attempt on the greeter side: attempt
+// id, helper mode, how long the helper took to come up, to be asked for
+// the password and to answer, and the outcome. Each attempt is one
+// key=value line in the auth log, ccheckpass logs its PAM phases under
+// the same attempt id. Nothing typed ever goes into a record.
+//
+// submit() only copies the record into a fixed ring and wakes the writer
+// thread, syslog() runs there, so a stalled journald never holds up the
+// GUI thread. When the ring is full the record is dropped and counted.
+class AuditLog
+{
+public:
+    enum class Helper {
+        None, // refused before any helper was involved
+        Direct, // started for the attempt
+        Preforked, // started before the attempt
+    };
+
+    struct Attempt {
+        int id = 0;
+        Helper helper = Helper::None;
+        qint64 requestedNs = 0;
+        qint64 helperReadyNs = 0;
+        qint64 passwordSentNs = 0;
+        qint64 resultNs = 0;
+        const char *result = "none";
+    };
+
+    static AuditLog *self();
+    static qint64 now();
+
+    // Never blocks
+    void submit(const Attempt &attempt);
+
+    // Waits up to timeoutMs for the records still queued, called on exit
+    void flush(int timeoutMs);
+
+private:
+    struct Slot {
+        Attempt attempt;
+        unsigned droppedBefore = 0;
+    };
+
+    AuditLog();
+    void run();
+    static void write(const Slot &slot);
+
+    static const unsigned s_ringSize = 16;
+
+    std::array<Slot, s_ringSize> m_ring;
+    std::atomic<unsigned> m_head { 0 }; // next slot to fill, GUI thread
+    std::atomic<unsigned> m_tail { 0 }; // next slot to write, writer thread
+    std::atomic<unsigned> m_dropped { 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<bool> m_idleWaiting { false };
+};
+
+#endif // AUDITLOG_H
@@ -23,9 +23,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "authenticator.h"
 
 #include "kcheckpass-enums.h"
+#include "stallwatchdog.h"
+#include "tracepoints.h"
 
 // Qt
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QFile>
 #include <QSocketNotifier>
 #include <QTimer>
@@ -38,42 +41,83 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/wait.h>
 #include <unistd.h>
 
+// an attempt answered without asking ccheckpass
+static void auditSkippedAttempt(int attemptId, const char *result)
+{
+    AuditLog::Attempt attempt;
+    attempt.id = attemptId;
+    attempt.requestedNs = attempt.resultNs = AuditLog::now();
+    attempt.result = result;
+    AuditLog::self()->submit(attempt);
+}
+
 Authenticator::Authenticator(AuthenticationMode mode, QObject *parent)
     : QObject(parent)
     , m_graceLockTimer(new QTimer(this))
+    , m_lockoutTimer(new QTimer(this))
+    , m_password(new PasswordModel(this))
     , m_checkPass(nullptr)
 {
+    m_graceLockTimer->setObjectName(QStringLiteral("graceLockTimer"));
     m_graceLockTimer->setSingleShot(true);
     m_graceLockTimer->setInterval(1500);
     connect(m_graceLockTimer, &QTimer::timeout, this, &Authenticator::graceLockedChanged);
 
+    // ticks once a second for the countdown, only while locked out
+    m_lockoutTimer->setObjectName(QStringLiteral("lockoutTimer"));
+    m_lockoutTimer->setInterval(1000);
+    connect(m_lockoutTimer, &QTimer::timeout, this, [this] {
+        if (!lockoutRemaining()) {
+            m_lockoutTimer->stop();
+            m_lockedUntil = 0;
+        }
+        Q_EMIT lockoutChanged();
+    });
+
     if (mode == AuthenticationMode::Delayed) {
         m_checkPass = new KCheckPass(AuthenticationMode::Delayed, this);
         setupCheckPass();
     }
 }
 
-Authenticator::~Authenticator() = default;
+Authenticator::~Authenticator()
+{
+    // bounded, a stalled journald must not hold up the exit
+    AuditLog::self()->flush(25);
+}
 
-void Authenticator::tryUnlock(const QString &password)
+void Authenticator::tryUnlock()
 {
     if (isGraceLocked()) {
         Q_EMIT failed();
         return;
     }
+    if (lockoutRemaining()) {
+        // ccheckpass would only run the PAM stack to be refused again
+        ++m_attemptId;
+        auditSkippedAttempt(m_attemptId, "locked_out");
+        Q_EMIT failed();
+        return;
+    }
     m_graceLockTimer->start();
     Q_EMIT graceLockedChanged();
 
+    ++m_attemptId;
+    LOCKER_TRACE1(unlock_requested, m_attemptId);
+
     if (!m_checkPass) {
         m_checkPass = new KCheckPass(AuthenticationMode::Direct, this);
-        m_checkPass->setPassword(password);
+        m_checkPass->setPassword(m_password->buffer());
+        m_checkPass->setAttemptId(m_attemptId);
         setupCheckPass();
     } else {
         if (!m_checkPass->isReady()) {
+            auditSkippedAttempt(m_attemptId, "busy");
             Q_EMIT failed();
             return;
         }
-        m_checkPass->setPassword(password);
+        m_checkPass->setPassword(m_password->buffer());
+        m_checkPass->setAttemptId(m_attemptId);
         m_checkPass->startAuth();
     }
 }
@@ -82,6 +126,7 @@ void Authenticator::setupCheckPass()
 {
     connect(m_checkPass, &KCheckPass::succeeded, this, &Authenticator::succeeded);
     connect(m_checkPass, &KCheckPass::failed, this, &Authenticator::failed);
+    connect(m_checkPass, &KCheckPass::lockedOut, this, &Authenticator::setLockout);
     connect(m_checkPass, &KCheckPass::message, this, &Authenticator::message);
     connect(m_checkPass, &KCheckPass::error, this, &Authenticator::error);
     connect(m_checkPass, &KCheckPass::destroyed, this, [this] {
@@ -95,6 +140,30 @@ bool Authenticator::isGraceLocked() const
     return m_graceLockTimer->isActive();
 }
 
+int Authenticator::lockoutRemaining() const
+{
+    if (!m_lockedUntil) {
+        return 0;
+    }
+    const qint64 left = m_lockedUntil - QDateTime::currentMSecsSinceEpoch();
+    return left > 0 ? int((left + 999) / 1000) : 0;
+}
+
+void Authenticator::setLockout(int seconds)
+{
+    LOCKER_TRACE2(locked_out, m_attemptId, seconds);
+    m_lockedUntil = QDateTime::currentMSecsSinceEpoch() + qint64(seconds) * 1000;
+    m_lockoutTimer->start();
+    Q_EMIT lockoutChanged();
+}
+
+static QString s_helper = QStringLiteral("ccheckpass");
+
+void KCheckPass::setHelper(const QString &helper)
+{
+    s_helper = helper;
+}
+
 KCheckPass::KCheckPass(AuthenticationMode mode, QObject *parent)
     : QObject(parent)
     , m_notifier(nullptr)
@@ -113,8 +182,20 @@ KCheckPass::~KCheckPass()
     reapVerify();
 }
 
+void KCheckPass::setAttemptId(int attemptId)
+{
+    m_attemptId = attemptId;
+
+    m_audit = AuditLog::Attempt();
+    m_audit.id = attemptId;
+    m_audit.helper = m_mode == AuthenticationMode::Delayed ? AuditLog::Helper::Preforked : AuditLog::Helper::Direct;
+    m_audit.requestedNs = AuditLog::now();
+    m_auditPending = true;
+}
+
 void KCheckPass::start()
 {
+    StallWatchdog::Operation operation("KCheckPass::start");
     int sfd[2];
     char fdbuf[16];
 
@@ -125,6 +206,8 @@ void KCheckPass::start()
         cantCheck();
         return;
     }
+    const QByteArray helper = QFile::encodeName(s_helper);
+    LOCKER_TRACE1(helper_fork, m_attemptId);
     if ((m_pid = ::fork()) < 0) {
         ::close(sfd[0]);
         ::close(sfd[1]);
@@ -134,12 +217,14 @@ void KCheckPass::start()
     if (!m_pid) {
         ::close(sfd[0]);
         sprintf(fdbuf, "%d", sfd[1]);
-        execlp(QFile::encodeName(QStringLiteral("ccheckpass")).data(), "kcheckpass", "-m", "classic", "-S", fdbuf, (char *)nullptr);
+        execlp(helper.constData(), "kcheckpass", "-m", "classic", "-S", fdbuf, (char *)nullptr);
         _exit(20);
     }
     ::close(sfd[1]);
+    LOCKER_TRACE2(helper_started, m_attemptId, m_pid);
     m_fd = sfd[0];
     m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    m_notifier->setObjectName(QStringLiteral("ccheckpass"));
     connect(m_notifier, &QSocketNotifier::activated, this, &KCheckPass::handleVerify);
 }
 
@@ -227,11 +312,13 @@ bool KCheckPass::GRecvArr(char **ret)
 
 void KCheckPass::handleVerify()
 {
+    StallWatchdog::Operation operation("KCheckPass::handleVerify");
     m_ready = false;
     int ret;
     char *arr;
 
     if (GRecvInt(&ret)) {
+        LOCKER_TRACE2(conv_request, m_attemptId, ret);
         switch (ret) {
         case ConvGetBinary:
             if (!GRecvArr(&arr)) {
@@ -249,15 +336,18 @@ void KCheckPass::handleVerify()
                 break;
             }
 
-            if (m_password.isNull()) {
+            if (!m_hasPassword) {
                 GSendStr(nullptr);
             } else {
-                QByteArray utf8pass = m_password.toUtf8();
-                GSendStr(utf8pass.constData());
+                // straight from the locked buffer, NUL included like GSendStr
+                GSendArr(m_password.size() + 1, m_password.constData());
                 GSendInt(IsPassword);
+                LOCKER_TRACE1(password_sent, m_attemptId);
+                m_audit.passwordSentNs = AuditLog::now();
             }
 
             m_password.clear();
+            m_hasPassword = false;
 
             if (arr) {
                 ::free(arr);
@@ -279,18 +369,34 @@ void KCheckPass::handleVerify()
             ::free(arr);
             return;
         case ConvPutAuthSucceeded:
+            LOCKER_TRACE2(auth_result, m_attemptId, AuthOk);
+            finishAudit("ok");
             Q_EMIT succeeded();
             return;
         case ConvPutAuthFailed:
+            LOCKER_TRACE2(auth_result, m_attemptId, AuthBad);
+            finishAudit("bad");
             Q_EMIT failed();
             return;
         case ConvPutAuthError:
         case ConvPutAuthAbort:
             cantCheck();
             return;
+        case ConvGetAttemptId:
+            GSendInt(m_attemptId);
+            return;
+        case ConvPutLockedOut: {
+            int seconds;
+            if (!GRecvInt(&seconds)) {
+                break;
+            }
+            Q_EMIT lockedOut(seconds);
+            return;
+        }
         case ConvPutReadyForAuthentication:
             m_ready = true;
             if (m_mode == AuthenticationMode::Direct) {
+                m_audit.helperReadyNs = AuditLog::now();
                 ::kill(m_pid, SIGUSR1);
             }
             return;
@@ -307,6 +413,7 @@ void KCheckPass::handleVerify()
 
 void KCheckPass::reapVerify()
 {
+    StallWatchdog::Operation operation("KCheckPass::reapVerify");
     m_notifier->setEnabled(false);
     m_notifier->deleteLater();
     m_notifier = nullptr;
@@ -319,14 +426,28 @@ void KCheckPass::reapVerify()
             return;
         }
     }
+    LOCKER_TRACE1(helper_reaped, m_attemptId);
 }
 
 void KCheckPass::cantCheck()
 {
+    finishAudit("error");
     // TODO: better signal?
     Q_EMIT failed();
 }
 
+void KCheckPass::finishAudit(const char *result)
+{
+    if (!m_auditPending) {
+        return;
+    }
+    m_auditPending = false;
+
+    m_audit.resultNs = AuditLog::now();
+    m_audit.result = result;
+    AuditLog::self()->submit(m_audit);
+}
+
 void KCheckPass::startAuth()
 {
     ::kill(m_pid, SIGUSR1);
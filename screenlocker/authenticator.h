@@ -22,6 +22,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QObject>
 
+#include "auditlog.h"
+#include "passwordmodel.h"
+
 class QSocketNotifier;
 class QTimer;
 class KCheckPass;
@@ -35,26 +38,42 @@ class Authenticator : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(bool graceLocked READ isGraceLocked NOTIFY graceLockedChanged)
+    Q_PROPERTY(PasswordModel *password READ password CONSTANT)
+    // Seconds until pam_faillock lets the user try again, 0 when not locked out
+    Q_PROPERTY(int lockoutRemaining READ lockoutRemaining NOTIFY lockoutChanged)
 public:
     explicit Authenticator(AuthenticationMode mode = AuthenticationMode::Direct, QObject *parent = nullptr);
     ~Authenticator() override;
 
     bool isGraceLocked() const;
+    int lockoutRemaining() const;
+
+    PasswordModel *password() const
+    {
+        return m_password;
+    }
 
 public Q_SLOTS:
-    void tryUnlock(const QString &password);
+    // Tries the password typed so far
+    void tryUnlock();
 
 Q_SIGNALS:
     void failed();
     void succeeded();
     void graceLockedChanged();
+    void lockoutChanged();
     void message(const QString &msg); // don't remove the "msg" param, used in QML!!!
     void error(const QString &err); // don't remove the "err" param, used in QML!!!
 
 private:
     void setupCheckPass();
+    void setLockout(int seconds);
     QTimer *m_graceLockTimer;
+    QTimer *m_lockoutTimer;
+    qint64 m_lockedUntil = 0; // wall clock, pam_faillock counts suspended time too
+    PasswordModel *m_password;
     KCheckPass *m_checkPass;
+    int m_attemptId = 0;
 };
 
 class KCheckPass : public QObject
@@ -71,16 +90,26 @@ public:
         return m_ready;
     }
 
-    void setPassword(const QString &password)
+    // Copied to a buffer of our own, the typed one may change meanwhile
+    void setPassword(const SecureBuffer &password)
     {
-        m_password = password;
+        m_password.assign(password);
+        m_hasPassword = true;
     }
 
+    // Shared with ccheckpass to correlate both sides of an unlock in traces
+    // and audit records, starts the audit record of the attempt
+    void setAttemptId(int attemptId);
+
     void startAuth();
 
+    // ccheckpass by default, test modes point this to a stand-in
+    static void setHelper(const QString &helper);
+
 Q_SIGNALS:
     void failed();
     void succeeded();
+    void lockedOut(int seconds);
     void message(const QString &);
     void error(const QString &);
 
@@ -90,6 +119,7 @@ private Q_SLOTS:
 private:
     void cantCheck();
     void reapVerify();
+    void finishAudit(const char *result);
     // kcheckpass interface
     int Reader(void *buf, int count);
     bool GRead(void *buf, int count);
@@ -100,10 +130,14 @@ private:
     bool GRecvInt(int *val);
     bool GRecvArr(char **buf);
 
-    QString m_password;
+    SecureBuffer m_password;
+    bool m_hasPassword = false;
     QSocketNotifier *m_notifier;
     int m_pid;
     int m_fd;
+    int m_attemptId = 0;
+    AuditLog::Attempt m_audit;
+    bool m_auditPending = false;
     bool m_ready = false;
     AuthenticationMode m_mode;
 };
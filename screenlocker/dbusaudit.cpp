@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dbusaudit.h"
+
+#include <config-screenlocker.h>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+DBusAudit *DBusAudit::instance()
+{
+    static DBusAudit audit;
+    return &audit;
+}
+
+DBusAudit::DBusAudit()
+    : m_enabled(ENABLE_DBUS_AUDIT && qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_DBUS_AUDIT") > 0)
+{
+    bool ok = false;
+    const int budgetMs = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_DBUS_BUDGET_MS", &ok);
+    if (ok) {
+        m_budgetUs = qint64(budgetMs) * 1000;
+    }
+}
+
+QDBusPendingCall DBusAudit::asyncCall(const QDBusConnection &connection, const QDBusMessage &message)
+{
+    return connection.asyncCall(message);
+}
+
+bool DBusAudit::registerService(QDBusConnection connection, const QString &name, const char *callSite)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool registered = connection.registerService(name);
+    instance()->record(QStringLiteral("org.freedesktop.DBus RequestName ") + name, timer.nsecsElapsed() / 1000, callSite);
+    return registered;
+}
+
+void DBusAudit::setCriticalPathDone()
+{
+    QMutexLocker locker(&m_mutex);
+    m_criticalPath = false;
+}
+
+void DBusAudit::record(const QString &target, qint64 durationUs, const char *callSite)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    const bool guiThread = QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread();
+
+    QMutexLocker locker(&m_mutex);
+    m_calls.append({ target, QString::fromLatin1(callSite), durationUs, guiThread, m_criticalPath });
+
+    if (guiThread) {
+        ++m_guiThreadCalls;
+        qWarning().nospace() << "Blocking D-Bus call " << target << " on the GUI thread took " << durationUs / 1000.0
+                             << " ms, called from " << callSite;
+    }
+
+    if (m_criticalPath && durationUs > m_budgetUs) {
+        ++m_violations;
+        qWarning().nospace() << "Blocking D-Bus call " << target << " took " << durationUs / 1000.0
+                             << " ms on the lock critical path, called from " << callSite;
+    }
+}
+
+int DBusAudit::budgetViolations() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_violations;
+}
+
+QString DBusAudit::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonArray calls;
+    for (const Call &call : m_calls) {
+        QJsonObject object;
+        object.insert(QStringLiteral("target"), call.target);
+        object.insert(QStringLiteral("callSite"), call.callSite);
+        object.insert(QStringLiteral("durationMs"), call.durationUs / 1000.0);
+        object.insert(QStringLiteral("guiThread"), call.guiThread);
+        object.insert(QStringLiteral("criticalPath"), call.criticalPath);
+        calls.append(object);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("enabled"), m_enabled);
+    root.insert(QStringLiteral("budgetMs"), m_budgetUs / 1000.0);
+    root.insert(QStringLiteral("budgetViolations"), m_violations);
+    root.insert(QStringLiteral("guiThreadCalls"), m_guiThreadCalls);
+    root.insert(QStringLiteral("calls"), calls);
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DBUSAUDIT_H
+#define DBUSAUDIT_H
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCall>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+// The way the greeter's own code talks D-Bus. Asynchronous calls pass
+// straight through; calls that wait for a reply are timed and, in builds
+// configured with ENABLE_DBUS_AUDIT and with CUTEFISH_SCREENLOCKER_DBUS_AUDIT=1
+// set, recorded with their call site and whether they blocked the GUI thread.
+// Calls the QML plugins make on their own are not seen.
+//
+// Calls on the lock critical path (until every screen has presented its
+// first frame) that take longer than CUTEFISH_SCREENLOCKER_DBUS_BUDGET_MS
+// (default 10) are counted as budget violations.
+class DBusAudit
+{
+public:
+    struct Call {
+        QString target;
+        QString callSite;
+        qint64 durationUs;
+        bool guiThread;
+        bool criticalPath;
+    };
+
+    static DBusAudit *instance();
+
+    static QDBusPendingCall asyncCall(const QDBusConnection &connection, const QDBusMessage &message);
+
+    static bool registerService(QDBusConnection connection, const QString &name, const char *callSite);
+
+    bool isEnabled() const { return m_enabled; }
+    void setCriticalPathDone();
+
+    int budgetViolations() const;
+    QString report() const;
+
+private:
+    DBusAudit();
+
+    void record(const QString &target, qint64 durationUs, const char *callSite);
+
+    bool m_enabled;
+    bool m_criticalPath = true;
+    qint64 m_budgetUs = 10000;
+
+    mutable QMutex m_mutex;
+    QList<Call> m_calls;
+    int m_violations = 0;
+    int m_guiThreadCalls = 0;
+};
+
+#endif // DBUSAUDIT_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "earlyinput.h"
+
+#include <QKeyEvent>
+
+void EarlyInput::addKey(const QKeyEvent *event)
+{
+    // nothing typed after Return belongs to this attempt
+    if (m_submit) {
+        return;
+    }
+
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        m_submit = true;
+        return;
+    case Qt::Key_Escape:
+        clear();
+        return;
+    case Qt::Key_Backspace:
+        m_text.chop(1);
+        return;
+    default:
+        break;
+    }
+
+    if (!event->text().isEmpty() && event->text().at(0).isPrint()) {
+        append(event->text());
+    }
+}
+
+void EarlyInput::append(QStringView text)
+{
+    if (!m_submit) {
+        m_text.append(text);
+    }
+}
+
+void EarlyInput::appendUtf8(const char *data, int size)
+{
+    if (!m_submit) {
+        m_text.appendUtf8(data, size);
+    }
+}
+
+void EarlyInput::clear()
+{
+    m_text.clear();
+    m_submit = false;
+}
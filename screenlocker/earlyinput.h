@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EARLYINPUT_H
+#define EARLYINPUT_H
+
+#include <QString>
+
+#include "securebuffer.h"
+
+class QKeyEvent;
+
+// Keys typed while the input grab is held but before the password field
+// has focus, kept in a SecureBuffer until the password model takes them.
+class EarlyInput
+{
+public:
+    EarlyInput() = default;
+
+    void addKey(const QKeyEvent *event);
+    void append(QStringView text);
+    void appendUtf8(const char *data, int size);
+    void setSubmit() { m_submit = true; }
+
+    const SecureBuffer &text() const { return m_text; }
+    bool submit() const { return m_submit; }
+    bool isEmpty() const { return m_text.isEmpty() && !m_submit; }
+
+    void clear();
+
+private:
+    Q_DISABLE_COPY(EarlyInput)
+
+    SecureBuffer m_text;
+    bool m_submit = false;
+};
+
+#endif // EARLYINPUT_H
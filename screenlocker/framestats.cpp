@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framestats.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMetaEnum>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QScreen>
+#include <QTimer>
+
+#include <algorithm>
+
+static const double s_percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+void FrameHistogram::record(qint64 usec)
+{
+    if (usec < 0) {
+        usec = 0;
+    }
+
+    ++m_counts[bucketFor(usec)];
+    ++m_total;
+    m_max = std::max(m_max, usec);
+}
+
+void FrameHistogram::reset()
+{
+    m_counts.fill(0);
+    m_total = 0;
+    m_max = 0;
+}
+
+qint64 FrameHistogram::percentile(double p) const
+{
+    if (!m_total) {
+        return 0;
+    }
+
+    const quint64 wanted = std::max<quint64>(1, quint64(p / 100.0 * m_total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+        seen += m_counts[i];
+        if (seen >= wanted) {
+            return std::min(highestValueOf(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+int FrameHistogram::bucketFor(quint64 usec)
+{
+    if (usec < SubBuckets) {
+        return int(usec);
+    }
+
+    int magnitude = 63 - __builtin_clzll(usec);
+    if (magnitude > MaxMagnitude) {
+        return Buckets - 1;
+    }
+
+    const int shift = magnitude - 4;
+    return SubBuckets + shift * SubBuckets + int(usec >> shift) - SubBuckets;
+}
+
+qint64 FrameHistogram::highestValueOf(int bucket)
+{
+    if (bucket < SubBuckets) {
+        return bucket;
+    }
+
+    const int shift = (bucket - SubBuckets) / SubBuckets;
+    const qint64 sub = (bucket - SubBuckets) % SubBuckets + SubBuckets;
+    return ((sub + 1) << shift) - 1;
+}
+
+static QString formatHistogram(const char *name, const FrameHistogram &histogram)
+{
+    QString line = QStringLiteral("  %1 count=%2").arg(QLatin1String(name), -14).arg(histogram.count());
+    for (double p : s_percentiles) {
+        line += QStringLiteral(" p%1=%2ms").arg(p).arg(histogram.percentile(p) / 1000.0, 0, 'f', 2);
+    }
+    line += QStringLiteral(" max=%1ms").arg(histogram.max() / 1000.0, 0, 'f', 2);
+    return line;
+}
+
+FrameRecorder::FrameRecorder(QQuickWindow *view, FrameStats *stats)
+    : QObject(view)
+    , m_view(view)
+    , m_stats(stats)
+{
+    connect(stats, &FrameStats::enabledChanged, this, &FrameRecorder::enabledChanged);
+
+    connect(view, &QQuickWindow::beforeSynchronizing, this, &FrameRecorder::beforeSynchronizing, Qt::DirectConnection);
+    connect(view, &QQuickWindow::afterSynchronizing, this, &FrameRecorder::afterSynchronizing, Qt::DirectConnection);
+    connect(view, &QQuickWindow::beforeRendering, this, &FrameRecorder::beforeRendering, Qt::DirectConnection);
+    connect(view, &QQuickWindow::afterRendering, this, &FrameRecorder::afterRendering, Qt::DirectConnection);
+    connect(view, &QQuickWindow::frameSwapped, this, &FrameRecorder::frameSwapped, Qt::DirectConnection);
+}
+
+bool FrameRecorder::isEnabled() const
+{
+    return m_stats->isEnabled();
+}
+
+void FrameRecorder::markInput(qint64 nsecs)
+{
+    // Only the first keystroke since the last frame counts, later
+    // ones ride along on the same frame
+    qint64 expected = 0;
+    m_pendingInput.compare_exchange_strong(expected, nsecs);
+}
+
+void FrameRecorder::beforeSynchronizing()
+{
+    if (m_stats->isEnabled()) {
+        m_syncStart = m_stats->now();
+    }
+}
+
+void FrameRecorder::afterSynchronizing()
+{
+    if (m_stats->isEnabled() && m_syncStart) {
+        QMutexLocker locker(&m_mutex);
+        m_sync.record((m_stats->now() - m_syncStart) / 1000);
+    }
+}
+
+void FrameRecorder::beforeRendering()
+{
+    if (m_stats->isEnabled()) {
+        m_renderStart = m_stats->now();
+    }
+}
+
+void FrameRecorder::afterRendering()
+{
+    if (m_stats->isEnabled() && m_renderStart) {
+        m_swapStart = m_stats->now();
+        QMutexLocker locker(&m_mutex);
+        m_render.record((m_swapStart - m_renderStart) / 1000);
+    }
+}
+
+void FrameRecorder::frameSwapped()
+{
+    if (!m_stats->isEnabled()) {
+        return;
+    }
+
+    const qint64 now = m_stats->now();
+    const qint64 input = m_pendingInput.exchange(0);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_swapStart) {
+        m_swap.record((now - m_swapStart) / 1000);
+    }
+    if (input) {
+        m_inputLatency.record((now - input) / 1000);
+    }
+}
+
+void FrameRecorder::updateSummary()
+{
+    QMutexLocker locker(&m_mutex);
+    m_summary = QStringLiteral("frames %1  sync p99 %2ms  render p99 %3ms  swap p99 %4ms  input p99 %5ms")
+                    .arg(m_swap.count())
+                    .arg(m_sync.percentile(99) / 1000.0, 0, 'f', 2)
+                    .arg(m_render.percentile(99) / 1000.0, 0, 'f', 2)
+                    .arg(m_swap.percentile(99) / 1000.0, 0, 'f', 2)
+                    .arg(m_inputLatency.percentile(99) / 1000.0, 0, 'f', 2);
+    locker.unlock();
+
+    Q_EMIT summaryChanged();
+}
+
+void FrameRecorder::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_syncStart = m_renderStart = m_swapStart = 0;
+    m_pendingInput = 0;
+    m_sync.reset();
+    m_render.reset();
+    m_swap.reset();
+    m_inputLatency.reset();
+}
+
+QString FrameRecorder::report() const
+{
+    QString screen = m_view->screen() ? m_view->screen()->name() : QString();
+
+    QMutexLocker locker(&m_mutex);
+    QStringList lines;
+    const auto api = m_view->rendererInterface() ? m_view->rendererInterface()->graphicsApi() : QSGRendererInterface::Unknown;
+    lines << QStringLiteral("view %1 (%2x%3 @%4, %5, %6 scene)")
+                 .arg(screen)
+                 .arg(m_view->width())
+                 .arg(m_view->height())
+                 .arg(m_view->devicePixelRatio())
+                 .arg(QString::fromLatin1(QMetaEnum::fromType<QSGRendererInterface::GraphicsApi>().valueToKey(api)))
+                 .arg(m_scene);
+    lines << formatHistogram("sync", m_sync);
+    lines << formatHistogram("render", m_render);
+    lines << formatHistogram("swap", m_swap);
+    lines << formatHistogram("input-to-swap", m_inputLatency);
+    return lines.join(QLatin1Char('\n'));
+}
+
+FrameStats::FrameStats(QObject *parent)
+    : QObject(parent)
+    , m_summaryTimer(new QTimer(this))
+{
+    m_clock.start();
+
+    m_summaryTimer->setObjectName(QStringLiteral("frameStatsSummaryTimer"));
+    m_summaryTimer->setInterval(1000);
+    connect(m_summaryTimer, &QTimer::timeout, this, [this] {
+        for (const auto &recorder : std::as_const(m_recorders)) {
+            if (recorder) {
+                recorder->updateSummary();
+            }
+        }
+    });
+
+    setEnabled(qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_FRAMESTATS") > 0);
+}
+
+FrameStats::~FrameStats() = default;
+
+void FrameStats::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled) {
+        return;
+    }
+
+    if (enabled) {
+        for (const auto &recorder : std::as_const(m_recorders)) {
+            if (recorder) {
+                recorder->reset();
+            }
+        }
+        m_summaryTimer->start();
+    } else {
+        m_summaryTimer->stop();
+    }
+
+    m_enabled = enabled;
+    Q_EMIT enabledChanged();
+}
+
+FrameRecorder *FrameStats::addView(QQuickWindow *view)
+{
+    m_recorders.removeAll(nullptr);
+
+    FrameRecorder *recorder = new FrameRecorder(view, this);
+    m_recorders << recorder;
+    return recorder;
+}
+
+void FrameStats::markInput()
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    const qint64 timestamp = now();
+    for (const auto &recorder : std::as_const(m_recorders)) {
+        if (recorder) {
+            recorder->markInput(timestamp);
+        }
+    }
+}
+
+QString FrameStats::report() const
+{
+    QStringList reports;
+    for (const auto &recorder : std::as_const(m_recorders)) {
+        if (recorder) {
+            reports << recorder->report();
+        }
+    }
+    return reports.join(QLatin1Char('\n'));
+}
+
+void FrameStats::dump() const
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    const QString text = report();
+    qInfo().noquote() << "Frame statistics:\n" << text;
+
+    const QString fileName = qEnvironmentVariable("CUTEFISH_SCREENLOCKER_FRAMESTATS_FILE");
+    if (!fileName.isEmpty()) {
+        QFile file(fileName);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            file.write(text.toUtf8());
+            file.write("\n");
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QPointer>
+
+#include <array>
+#include <atomic>
+
+class QQuickWindow;
+class QTimer;
+class FrameStats;
+
+// Log-linear histogram of microsecond values, 16 sub-buckets per power
+// of two (about 6% precision), in the spirit of HdrHistogram.
+class FrameHistogram
+{
+public:
+    void record(qint64 usec);
+    void reset();
+
+    quint64 count() const { return m_total; }
+    qint64 max() const { return m_max; }
+    qint64 percentile(double p) const;
+
+private:
+    static constexpr int SubBuckets = 16;
+    static constexpr int MaxMagnitude = 40;
+    static constexpr int Buckets = SubBuckets + (MaxMagnitude - 3) * SubBuckets;
+
+    static int bucketFor(quint64 usec);
+    static qint64 highestValueOf(int bucket);
+
+    std::array<quint32, Buckets> m_counts {};
+    quint64 m_total = 0;
+    qint64 m_max = 0;
+};
+
+// Per view recorder, exposed to QML as "frameStats" for the overlay
+class FrameRecorder : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(QString summary READ summary NOTIFY summaryChanged)
+
+public:
+    explicit FrameRecorder(QQuickWindow *view, FrameStats *stats);
+
+    bool isEnabled() const;
+    QString summary() const { return m_summary; }
+
+    // Which of the lock screen scenes the view shows, for the report
+    void setScene(const QString &scene) { m_scene = scene; }
+
+    void markInput(qint64 nsecs);
+    void updateSummary();
+    void reset();
+    QString report() const;
+
+signals:
+    void enabledChanged();
+    void summaryChanged();
+
+private:
+    // Called on the render thread
+    void beforeSynchronizing();
+    void afterSynchronizing();
+    void beforeRendering();
+    void afterRendering();
+    void frameSwapped();
+
+private:
+    QQuickWindow *m_view;
+    FrameStats *m_stats;
+    QString m_summary;
+    QString m_scene;
+
+    qint64 m_syncStart = 0;
+    qint64 m_renderStart = 0;
+    qint64 m_swapStart = 0;
+    std::atomic<qint64> m_pendingInput { 0 };
+
+    mutable QMutex m_mutex;
+    FrameHistogram m_sync;
+    FrameHistogram m_render;
+    FrameHistogram m_swap;
+    FrameHistogram m_inputLatency;
+};
+
+// Frame timing and keystroke-to-frameSwapped latency for every view.
+// Enable with CUTEFISH_SCREENLOCKER_FRAMESTATS=1 or over D-Bus, dump()
+// writes the histograms to stderr and CUTEFISH_SCREENLOCKER_FRAMESTATS_FILE.
+class FrameStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameStats(QObject *parent = nullptr);
+    ~FrameStats() override;
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+
+    FrameRecorder *addView(QQuickWindow *view);
+    void markInput();
+
+    QString report() const;
+    void dump() const;
+
+signals:
+    void enabledChanged();
+
+private:
+    std::atomic<bool> m_enabled { false };
+    QElapsedTimer m_clock;
+    QTimer *m_summaryTimer;
+    QList<QPointer<FrameRecorder>> m_recorders;
+};
+
+#endif // FRAMESTATS_H
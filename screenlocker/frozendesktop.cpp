@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frozendesktop.h"
+#include "tracepoints.h"
+#include "wallpaperpyramid.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+
+#include <config-screenlocker.h>
+
+#if HAVE_XCB_SHM
+#include <xcb/shm.h>
+#include <xcb/xcb.h>
+
+// system
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+FrozenDesktop::FrozenDesktop(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+FrozenDesktop::~FrozenDesktop()
+{
+    m_pool.waitForDone();
+}
+
+bool FrozenDesktop::isRequested()
+{
+    return qEnvironmentVariable("CUTEFISH_SCREENLOCKER_BACKGROUND") == QLatin1String("desktop");
+}
+
+bool FrozenDesktop::capture(const QList<QRect> &screens)
+{
+#if HAVE_XCB_SHM && QT_CONFIG(xcb)
+    if (QGuiApplication::platformName() != QLatin1String("xcb") || screens.isEmpty()) {
+        return false;
+    }
+
+    auto *x11 = qGuiApp->nativeInterface<QNativeInterface::QX11Application>();
+    xcb_connection_t *connection = x11 ? x11->connection() : nullptr;
+    if (!connection) {
+        return false;
+    }
+
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_shm_id);
+    if (!extension || !extension->present) {
+        qWarning() << "No MIT-SHM, the desktop can not be used as lock background";
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 total = 0;
+    for (const QRect &screen : screens) {
+        total += qint64(screen.width()) * screen.height() * 4;
+    }
+
+    const int shmId = ::shmget(IPC_PRIVATE, total, IPC_CREAT | 0600);
+    if (shmId < 0) {
+        return false;
+    }
+    auto *segment = static_cast<uchar *>(::shmat(shmId, nullptr, 0));
+    if (segment == reinterpret_cast<uchar *>(-1)) {
+        ::shmctl(shmId, IPC_RMID, nullptr);
+        return false;
+    }
+
+    const xcb_shm_seg_t seg = xcb_generate_id(connection);
+    xcb_shm_attach(connection, seg, shmId, false);
+
+    const xcb_window_t root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+
+    // every screen goes right behind the previous one in the segment
+    bool ok = true;
+    qint64 offset = 0;
+    for (const QRect &screen : screens) {
+        xcb_shm_get_image_cookie_t cookie = xcb_shm_get_image(connection, root,
+                                                              screen.x(), screen.y(), screen.width(), screen.height(),
+                                                              ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, offset);
+        xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(connection, cookie, nullptr);
+
+        // only 32 bits per pixel true color is read in place
+        ok = reply && (reply->depth == 24 || reply->depth == 32)
+             && reply->size == quint32(screen.width()) * screen.height() * 4;
+        free(reply);
+        if (!ok) {
+            break;
+        }
+        offset += qint64(screen.width()) * screen.height() * 4;
+    }
+
+    xcb_shm_detach(connection, seg);
+    xcb_flush(connection);
+    // freed for good once we detach as well
+    ::shmctl(shmId, IPC_RMID, nullptr);
+
+    if (!ok) {
+        qWarning() << "Could not capture the desktop for the lock background";
+        ::shmdt(segment);
+        return false;
+    }
+
+    LOCKER_TRACE1(desktop_captured, timer.nsecsElapsed() / 1000);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_screens = screens;
+        m_backgrounds.clear();
+        m_pending = true;
+    }
+
+    m_pool.start([this, segment] {
+        process(segment);
+    });
+
+    return true;
+#else
+    Q_UNUSED(screens)
+    return false;
+#endif
+}
+
+void FrozenDesktop::process(uchar *segment)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<QImage> backgrounds;
+    qint64 offset = 0;
+    for (const QRect &screen : std::as_const(m_screens)) {
+        // a view on the capture, blurred() makes the copy we keep
+        const QImage capture(segment + offset, screen.width(), screen.height(), screen.width() * 4, QImage::Format_RGB32);
+        QImage image = WallpaperPyramid::blurred(capture);
+
+        // the X server leaves the padding byte undefined, RGB32 wants it opaque
+        for (int y = 0; y < image.height(); ++y) {
+            auto *pixels = reinterpret_cast<quint32 *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                pixels[x] |= 0xff000000;
+            }
+        }
+
+        backgrounds << image;
+        offset += qint64(screen.width()) * screen.height() * 4;
+    }
+
+#if HAVE_XCB_SHM
+    ::shmdt(segment);
+#endif
+
+    LOCKER_TRACE1(desktop_blurred, timer.nsecsElapsed() / 1000);
+
+    QMutexLocker locker(&m_mutex);
+    m_backgrounds = backgrounds;
+    m_pending = false;
+    m_processed.wakeAll();
+}
+
+int FrozenDesktop::indexOf(const QRect &screen) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_screens.indexOf(screen);
+}
+
+QImage FrozenDesktop::background(int index)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_pending) {
+        m_processed.wait(&m_mutex);
+    }
+    return m_backgrounds.value(index);
+}
+
+FrozenDesktopProvider::FrozenDesktopProvider(FrozenDesktop *desktop)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , m_desktop(desktop)
+{
+}
+
+QImage FrozenDesktopProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    Q_UNUSED(requestedSize)
+
+    const QImage image = m_desktop->background(id.toInt());
+
+    if (size) {
+        *size = image.size();
+    }
+    return image;
+}
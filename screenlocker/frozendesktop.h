@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FROZENDESKTOP_H
+#define FROZENDESKTOP_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QQuickImageProvider>
+#include <QRect>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+// The desktop as it was when the lock started, blurred, as an alternative
+// lock background (CUTEFISH_SCREENLOCKER_BACKGROUND=desktop). Every screen
+// is captured with MIT-SHM into one shared memory segment, which the worker
+// then reads in place to downscale and blur, so no file is read and no copy
+// of the full-size capture is made.
+class FrozenDesktop : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrozenDesktop(QObject *parent = nullptr);
+    ~FrozenDesktop() override;
+
+    static bool isRequested();
+
+    // Geometries in device pixels; call before any lock window is mapped
+    bool capture(const QList<QRect> &screens);
+
+    // Index of a captured screen, -1 if it was not there at capture time
+    int indexOf(const QRect &screen) const;
+
+    // Thread-safe, waits until the worker is done with the captures
+    QImage background(int index);
+
+private:
+    void process(uchar *segment);
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_processed;
+    bool m_pending = false;
+    QList<QRect> m_screens;
+    QList<QImage> m_backgrounds;
+
+    // Last, so a running blur finishes before anything else goes away
+    QThreadPool m_pool;
+};
+
+// image://desktop/<index>
+class FrozenDesktopProvider : public QQuickImageProvider
+{
+public:
+    explicit FrozenDesktopProvider(FrozenDesktop *desktop);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+private:
+    FrozenDesktop *m_desktop;
+};
+
+#endif // FROZENDESKTOP_H
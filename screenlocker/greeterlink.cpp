@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "greeterlink.h"
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+// system
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int s_maxLine = 256;
+static const int s_maxInput = 65536;
+
+GreeterLink::GreeterLink(int fd, QObject *parent)
+    : QObject(parent)
+    , m_fd(fd)
+    , m_notifier(nullptr)
+{
+    if (::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        qWarning() << "Invalid greeter link descriptor" << fd;
+        m_fd = -1;
+        return;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    m_notifier->setObjectName(QStringLiteral("greeterLink"));
+    connect(m_notifier, &QSocketNotifier::activated, this, &GreeterLink::onReadable);
+}
+
+GreeterLink::~GreeterLink()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool GreeterLink::isConnected() const
+{
+    return m_fd >= 0;
+}
+
+void GreeterLink::send(const QByteArray &message)
+{
+    if (!writeAll(message.constData(), message.size()) || !writeAll("\n", 1)) {
+        close();
+    }
+}
+
+void GreeterLink::sendInput(const SecureBuffer &text)
+{
+    send("input " + QByteArray::number(text.size()));
+    if (!writeAll(text.constData(), text.size())) {
+        close();
+    }
+}
+
+bool GreeterLink::writeAll(const char *data, int size)
+{
+    if (m_fd < 0) {
+        return false;
+    }
+
+    // the messages are tiny, the socket buffer only fills up when the
+    // other side hangs, and then the ping times out anyway
+    while (size > 0) {
+        // no SIGPIPE when the other side is gone
+        const ssize_t ret = ::send(m_fd, data, size, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            pollfd pfd = { m_fd, POLLOUT, 0 };
+            if (errno != EAGAIN || ::poll(&pfd, 1, 100) <= 0) {
+                return false;
+            }
+            continue;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+void GreeterLink::onReadable()
+{
+    while (m_fd >= 0) {
+        if (m_inputLeft > 0) {
+            const int ret = m_input.readFrom(m_fd, m_inputLeft);
+            if (ret < 0 && (errno == EAGAIN || errno == EINTR)) {
+                return;
+            }
+            if (ret <= 0) {
+                close();
+                return;
+            }
+            m_inputLeft -= ret;
+            if (!m_inputLeft) {
+                Q_EMIT inputReceived(m_input);
+                m_input.clear();
+            }
+            continue;
+        }
+
+        char c;
+        const ssize_t ret = ::read(m_fd, &c, 1);
+        if (ret < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        if (ret <= 0 || m_line.size() >= s_maxLine) {
+            close();
+            return;
+        }
+        if (c != '\n') {
+            m_line.append(c);
+            continue;
+        }
+
+        const QByteArray line = m_line.trimmed();
+        m_line.clear();
+        if (line.startsWith("input ")) {
+            m_inputLeft = line.mid(6).toInt();
+            if (m_inputLeft < 0 || m_inputLeft > s_maxInput) {
+                close();
+                return;
+            }
+        } else if (line == "ping") {
+            send("pong");
+        } else if (!line.isEmpty()) {
+            Q_EMIT messageReceived(line);
+        }
+    }
+}
+
+void GreeterLink::close()
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    // may run from within its activated() signal
+    m_notifier->setEnabled(false);
+    m_notifier->deleteLater();
+    m_notifier = nullptr;
+    ::close(m_fd);
+    m_fd = -1;
+    m_input.clear();
+    m_inputLeft = 0;
+
+    Q_EMIT disconnected();
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GREETERLINK_H
+#define GREETERLINK_H
+
+#include <QObject>
+
+#include "securebuffer.h"
+
+class QSocketNotifier;
+
+// Line based connection between the lock holder and a greeter process,
+// over a socketpair inherited by the greeter.
+//
+// holder -> greeter: "show", "grab", "ping", "submit", "input <length>"
+// greeter -> holder: "ready", "unlocked", "pong", "service <bus name>"
+//
+// "input" is followed by <length> raw bytes of typed text. They are
+// written from and read into a SecureBuffer directly on the descriptor,
+// so they never pass through a Qt or heap buffer. For that the link does
+// its own reads, one byte at a time up to the end of a line, which never
+// reads ahead into the bytes of an "input".
+class GreeterLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GreeterLink(int fd, QObject *parent = nullptr);
+    ~GreeterLink() override;
+
+    bool isConnected() const;
+    void send(const QByteArray &message);
+    void sendInput(const SecureBuffer &text);
+
+signals:
+    void messageReceived(const QByteArray &message);
+    // Only valid during the emission, the buffer is wiped afterwards
+    void inputReceived(const SecureBuffer &text);
+    void disconnected();
+
+private:
+    void onReadable();
+    bool writeAll(const char *data, int size);
+    void close();
+
+private:
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QByteArray m_line; // never holds typed text
+    int m_inputLeft = 0;
+    SecureBuffer m_input;
+};
+
+#endif // GREETERLINK_H
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iconatlas.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+IconAtlas *IconAtlas::self()
+{
+    static IconAtlas s_self;
+    return &s_self;
+}
+
+IconAtlas::IconAtlas()
+    : m_enabled(qEnvironmentVariable("CUTEFISH_SCREENLOCKER_ICON_ATLAS") != QLatin1String("0"))
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    // only present when the build found QtSvg for the atlas tool
+    QFile table(QStringLiteral(":/iconatlas.json"));
+    if (!table.open(QIODevice::ReadOnly) || !m_atlas.load(QStringLiteral(":/iconatlas.png"))) {
+        m_enabled = false;
+        return;
+    }
+    // what the scene graph uploads, so no icon is converted on its way there
+    m_atlas.convertTo(QImage::Format_ARGB32_Premultiplied);
+
+    const QJsonObject icons = QJsonDocument::fromJson(table.readAll()).object().value(QStringLiteral("icons")).toObject();
+    for (auto it = icons.constBegin(); it != icons.constEnd(); ++it) {
+        const QJsonArray rect = it.value().toArray();
+        m_rects.insert(it.key(), QRect(rect.at(0).toInt(), rect.at(1).toInt(), rect.at(2).toInt(), rect.at(3).toInt()));
+    }
+}
+
+QImage IconAtlas::icon(const QString &name, const QSize &pixelSize)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QImage image;
+    bool hit = false;
+
+    // atlas icons are square, keyed by their edge in pixels
+    if (m_enabled && pixelSize.width() == pixelSize.height()) {
+        const QRect rect = m_rects.value(QStringLiteral("%1@%2").arg(name).arg(pixelSize.width()));
+        if (rect.isValid() && m_atlas.rect().contains(rect)) {
+            // shares the pixels, the atlas is never changed or freed
+            image = QImage(m_atlas.constScanLine(rect.y()) + rect.x() * 4, rect.width(), rect.height(), m_atlas.bytesPerLine(), m_atlas.format());
+            hit = true;
+        }
+    }
+
+    if (!hit) {
+        image = renderSvg(name, pixelSize);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    hit ? ++m_hits : ++m_misses;
+    m_totalNs += timer.nsecsElapsed();
+
+    return image;
+}
+
+QImage IconAtlas::renderSvg(const QString &name, const QSize &pixelSize) const
+{
+    QImageReader reader(QStringLiteral(":/images/%1.svg").arg(name));
+    if (pixelSize.isValid()) {
+        QSize size = reader.size();
+        size.scale(pixelSize, Qt::KeepAspectRatio);
+        reader.setScaledSize(size);
+    }
+    return reader.read();
+}
+
+QString IconAtlas::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonObject root;
+    root.insert(QStringLiteral("enabled"), m_enabled);
+    root.insert(QStringLiteral("atlasIcons"), m_rects.count());
+    root.insert(QStringLiteral("hits"), m_hits);
+    root.insert(QStringLiteral("misses"), m_misses);
+    root.insert(QStringLiteral("totalMs"), m_totalNs / 1000000.0);
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+IconAtlasProvider::IconAtlasProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image)
+{
+}
+
+QImage IconAtlasProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    // requestedSize is the sourceSize in device pixels
+    const QImage image = IconAtlas::self()->icon(id, requestedSize);
+
+    if (size) {
+        *size = image.size();
+    }
+    return image;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICONATLAS_H
+#define ICONATLAS_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QQuickImageProvider>
+
+// The lock screen icons, rasterized at build time (tools/iconatlas.cpp) for
+// the sizes and device pixel ratios they are shown at and packed into one
+// image. Icons are handed out as views into it instead of parsing and
+// rendering the SVG while the lock screen comes up; sizes missing from the
+// atlas are still rendered from the SVG. CUTEFISH_SCREENLOCKER_ICON_ATLAS=0
+// disables the atlas, to compare startup with and without it.
+//
+// On the GPU side no texture per icon is made either: the scene graph packs
+// images this small into its own shared atlas texture per window, which a
+// requestTexture() of ours would only bypass.
+class IconAtlas
+{
+public:
+    static IconAtlas *self();
+
+    QImage icon(const QString &name, const QSize &pixelSize);
+    QString report() const;
+
+private:
+    IconAtlas();
+    QImage renderSvg(const QString &name, const QSize &pixelSize) const;
+
+private:
+    mutable QMutex m_mutex;
+    QImage m_atlas;
+    QHash<QString, QRect> m_rects;
+    bool m_enabled;
+    int m_hits = 0;
+    int m_misses = 0;
+    qint64 m_totalNs = 0;
+};
+
+// image://icons/<path below images/ without .svg>, e.g.
+// image://icons/dark/media-skip-forward-symbolic
+class IconAtlasProvider : public QQuickImageProvider
+{
+public:
+    IconAtlasProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+};
+
+#endif // ICONATLAS_H
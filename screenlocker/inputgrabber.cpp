@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "inputgrabber.h"
+#include "tracepoints.h"
+
+#include <QDebug>
+#include <QGuiApplication>
+#include <QTimer>
+
+#include <xcb/xcb.h>
+
+// system
+#include <stdlib.h>
+#include <unistd.h>
+
+static const int s_initialBackoff = 5;
+static const int s_maxBackoff = 250;
+
+// Report over D-Bus once the grab has not been secured for this long, but keep trying
+static const int s_failureReportMs = 3000;
+
+// Polling for the grab replies. Qt's reader thread owns the connection, so
+// there is nothing to wait on; half a frame at 60 Hz adds little to an
+// attempt, and the timer only runs while a reply is outstanding.
+static const int s_replyPollMs = 8;
+
+static xcb_connection_t *xcbConnection()
+{
+#if QT_CONFIG(xcb)
+    if (QGuiApplication::platformName() != QLatin1String("xcb")) {
+        return nullptr;
+    }
+
+    auto *x11 = qGuiApp->nativeInterface<QNativeInterface::QX11Application>();
+    return x11 ? x11->connection() : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+static QString grabStatusString(uint8_t status)
+{
+    switch (status) {
+    case XCB_GRAB_STATUS_ALREADY_GRABBED:
+        return QStringLiteral("already grabbed by another client");
+    case XCB_GRAB_STATUS_INVALID_TIME:
+        return QStringLiteral("invalid time");
+    case XCB_GRAB_STATUS_NOT_VIEWABLE:
+        return QStringLiteral("window not viewable");
+    case XCB_GRAB_STATUS_FROZEN:
+        return QStringLiteral("frozen by another grab");
+    default:
+        return QStringLiteral("status %1").arg(status);
+    }
+}
+
+InputGrabber::InputGrabber(QObject *parent)
+    : QObject(parent)
+    , m_retryTimer(new QTimer(this))
+    , m_replyTimer(new QTimer(this))
+{
+    m_clock.start();
+
+    m_retryTimer->setObjectName(QStringLiteral("grabRetryTimer"));
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &InputGrabber::attempt);
+
+    m_replyTimer->setObjectName(QStringLiteral("grabReplyTimer"));
+    m_replyTimer->setInterval(s_replyPollMs);
+    connect(m_replyTimer, &QTimer::timeout, this, &InputGrabber::collectReplies);
+}
+
+InputGrabber::~InputGrabber() = default;
+
+void InputGrabber::grab(QWindow *window)
+{
+    if (window == m_window && isSecured()) {
+        return;
+    }
+
+    // a second grab of ours simply moves it to the new window
+    m_window = window;
+    m_keyboard = false;
+    m_pointer = false;
+    m_backoff = 0;
+    m_failureReported = false;
+    m_grabClock.start();
+
+    m_retryTimer->stop();
+    discardReplies();
+    attempt();
+}
+
+void InputGrabber::release()
+{
+    m_retryTimer->stop();
+    discardReplies();
+
+    if (xcb_connection_t *c = xcbConnection()) {
+        xcb_ungrab_keyboard(c, XCB_CURRENT_TIME);
+        xcb_ungrab_pointer(c, XCB_CURRENT_TIME);
+        xcb_flush(c);
+    } else if (m_window) {
+        m_window->setKeyboardGrabEnabled(false);
+        m_window->setMouseGrabEnabled(false);
+    }
+
+    m_window = nullptr;
+    m_keyboard = false;
+    m_pointer = false;
+}
+
+void InputGrabber::attempt()
+{
+    if (!m_window) {
+        return;
+    }
+
+    ++m_attempts;
+
+    if (xcbConnection()) {
+        sendGrabs();
+        return;
+    }
+
+    if (!m_keyboard && !(m_keyboard = m_window->setKeyboardGrabEnabled(true))) {
+        m_lastError = QStringLiteral("keyboard grab refused");
+    }
+    if (!m_pointer && !(m_pointer = m_window->setMouseGrabEnabled(true))) {
+        m_lastError = QStringLiteral("pointer grab refused");
+    }
+    finishAttempt();
+}
+
+void InputGrabber::finishAttempt()
+{
+    if (isSecured()) {
+        LOCKER_TRACE1(input_secured, m_attempts);
+
+        if (!m_wasSecured) {
+            m_wasSecured = true;
+            Q_EMIT secured(m_clock.nsecsElapsed());
+        }
+        return;
+    }
+
+    if (!m_failureReported && m_grabClock.elapsed() > s_failureReportMs) {
+        m_failureReported = true;
+        qWarning() << "Could not grab input:" << m_lastError;
+        Q_EMIT failed(m_lastError);
+    }
+
+    m_backoff = m_backoff ? qMin(m_backoff * 2, s_maxBackoff) : s_initialBackoff;
+    m_retryTimer->start(m_backoff);
+}
+
+void InputGrabber::sendGrabs()
+{
+    xcb_connection_t *c = xcbConnection();
+
+    if (!m_keyboard) {
+        m_keyboardSequence = xcb_grab_keyboard_unchecked(c, true, m_window->winId(), XCB_CURRENT_TIME,
+                                                         XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC).sequence;
+    }
+    if (!m_pointer) {
+        const uint16_t eventMask = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE
+                                   | XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_ENTER_WINDOW
+                                   | XCB_EVENT_MASK_LEAVE_WINDOW;
+        m_pointerSequence = xcb_grab_pointer_unchecked(c, true, m_window->winId(), eventMask,
+                                                       XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+                                                       XCB_NONE, XCB_NONE, XCB_CURRENT_TIME).sequence;
+    }
+    xcb_flush(c);
+
+    m_replyTimer->start();
+}
+
+void InputGrabber::collectReplies()
+{
+    xcb_connection_t *c = xcbConnection();
+    if (!c) {
+        discardReplies();
+        return;
+    }
+
+    // a reply of null means the request failed, the error went to Qt's event queue
+    void *reply = nullptr;
+    if (m_keyboardSequence && xcb_poll_for_reply(c, m_keyboardSequence, &reply, nullptr)) {
+        const uint8_t status = reply ? static_cast<xcb_grab_keyboard_reply_t *>(reply)->status : XCB_GRAB_STATUS_INVALID_TIME;
+        free(reply);
+        m_keyboardSequence = 0;
+        m_keyboard = status == XCB_GRAB_STATUS_SUCCESS;
+        if (!m_keyboard) {
+            m_lastError = QStringLiteral("keyboard: ") + grabStatusString(status);
+        }
+    }
+
+    reply = nullptr;
+    if (m_pointerSequence && xcb_poll_for_reply(c, m_pointerSequence, &reply, nullptr)) {
+        const uint8_t status = reply ? static_cast<xcb_grab_pointer_reply_t *>(reply)->status : XCB_GRAB_STATUS_INVALID_TIME;
+        free(reply);
+        m_pointerSequence = 0;
+        m_pointer = status == XCB_GRAB_STATUS_SUCCESS;
+        if (!m_pointer) {
+            m_lastError = QStringLiteral("pointer: ") + grabStatusString(status);
+        }
+    }
+
+    if (m_keyboardSequence || m_pointerSequence) {
+        return;
+    }
+
+    m_replyTimer->stop();
+    finishAttempt();
+}
+
+void InputGrabber::discardReplies()
+{
+    xcb_connection_t *c = xcbConnection();
+
+    if (c && m_keyboardSequence) {
+        xcb_discard_reply(c, m_keyboardSequence);
+    }
+    if (c && m_pointerSequence) {
+        xcb_discard_reply(c, m_pointerSequence);
+    }
+    m_keyboardSequence = 0;
+    m_pointerSequence = 0;
+
+    m_replyTimer->stop();
+}
+
+int InputGrabber::holdCompetingGrab(int ms)
+{
+    xcb_connection_t *c = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(c)) {
+        xcb_disconnect(c);
+        return 1;
+    }
+
+    // the root window is always viewable
+    const xcb_window_t root = xcb_setup_roots_iterator(xcb_get_setup(c)).data->root;
+
+    xcb_grab_keyboard_reply_t *keyboard = xcb_grab_keyboard_reply(c,
+        xcb_grab_keyboard(c, false, root, XCB_CURRENT_TIME, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC), nullptr);
+    xcb_grab_pointer_reply_t *pointer = xcb_grab_pointer_reply(c,
+        xcb_grab_pointer(c, false, root, XCB_EVENT_MASK_BUTTON_PRESS, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+                         XCB_NONE, XCB_NONE, XCB_CURRENT_TIME), nullptr);
+
+    const bool grabbed = keyboard && keyboard->status == XCB_GRAB_STATUS_SUCCESS
+                         && pointer && pointer->status == XCB_GRAB_STATUS_SUCCESS;
+    free(keyboard);
+    free(pointer);
+
+    if (grabbed) {
+        ::usleep(useconds_t(ms) * 1000);
+    }
+
+    xcb_disconnect(c);
+    return grabbed ? 0 : 1;
+}
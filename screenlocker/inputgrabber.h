@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUTGRABBER_H
+#define INPUTGRABBER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QWindow>
+
+class QTimer;
+
+// Keyboard and pointer grab on one window, retried with a bounded backoff
+// until both are held. Another client holding a grab (an open menu, a
+// fullscreen game) only delays the lock instead of leaving it without
+// input. On X11 the grabs go through xcb directly so the result of every
+// attempt is known. The requests are sent unchecked and their replies are
+// collected when the connection becomes readable, so the GUI thread never
+// waits on the X server; elsewhere QWindow's grab functions are used.
+class InputGrabber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InputGrabber(QObject *parent = nullptr);
+    ~InputGrabber() override;
+
+    void grab(QWindow *window);
+    void release();
+
+    bool isSecured() const { return m_keyboard && m_pointer; }
+    int attempts() const { return m_attempts; }
+
+    // Holds a keyboard and pointer grab for the given time, as a stand-in
+    // for a client competing with the locker (--hold-grab <ms>)
+    static int holdCompetingGrab(int ms);
+
+signals:
+    // elapsed since the grabber was created, i.e. since the lock started
+    void secured(qint64 elapsedNs);
+    void failed(const QString &reason);
+
+private:
+    void attempt();
+    void finishAttempt();
+    void collectReplies();
+    void discardReplies();
+    void sendGrabs();
+
+private:
+    QPointer<QWindow> m_window;
+    QTimer *m_retryTimer;
+    // the X server answers on the connection Qt reads events from, the
+    // replies are polled for
+    QTimer *m_replyTimer;
+    unsigned int m_keyboardSequence = 0; // 0 when no reply is outstanding
+    unsigned int m_pointerSequence = 0;
+    QElapsedTimer m_clock;
+    QElapsedTimer m_grabClock;
+    int m_attempts = 0;
+    int m_backoff = 0;
+    bool m_keyboard = false;
+    bool m_pointer = false;
+    bool m_failureReported = false;
+    bool m_wasSecured = false;
+    QString m_lastError;
+};
+
+#endif // INPUTGRABBER_H
@@ -60,6 +60,8 @@ typedef enum {
     ConvPutAuthError,
     ConvPutAuthAbort,
     ConvPutReadyForAuthentication,
+    ConvGetAttemptId,
+    ConvPutLockedOut, /* followed by the seconds left, before ConvPutAuthFailed */
 } ConvRequest;
 
 /* these must match the defs in kgreeterplugin.h */
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lockholder.h"
+#include "greeterlink.h"
+#include "inputgrabber.h"
+#include "tracepoints.h"
+
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QScreen>
+#include <QTimer>
+
+// system
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// A greeter that does not answer a ping within this interval is considered hung
+static const int s_pingInterval = 10000;
+static const int s_maxSpareBackoff = 30000;
+
+CoverWindow::CoverWindow(QScreen *screen)
+{
+    setScreen(screen);
+    setFlags(Qt::FramelessWindowHint);
+    setGeometry(screen->geometry());
+}
+
+void CoverWindow::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    painter.fillRect(QRect(QPoint(0, 0), size()), Qt::black);
+}
+
+void CoverWindow::exposeEvent(QExposeEvent *event)
+{
+    QRasterWindow::exposeEvent(event);
+
+    if (isExposed()) {
+        Q_EMIT exposed();
+    }
+}
+
+void CoverWindow::keyPressEvent(QKeyEvent *event)
+{
+    Q_EMIT keyPressed(event);
+}
+
+GreeterProcess::GreeterProcess(bool standby, QObject *parent)
+    : QObject(parent)
+    , m_process(new QProcess(this))
+    , m_standby(standby)
+{
+    m_process->setProcessChannelMode(QProcess::ForwardedChannels);
+
+    connect(m_process, &QProcess::finished, this, &GreeterProcess::finished);
+}
+
+GreeterProcess::~GreeterProcess()
+{
+    if (m_process->state() != QProcess::NotRunning) {
+        disconnect(m_process, nullptr, this, nullptr);
+        m_process->kill();
+        m_process->waitForFinished(1000);
+    }
+}
+
+bool GreeterProcess::start()
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        qWarning() << "Could not create greeter socket pair";
+        return false;
+    }
+
+    // fds[1] is inherited by the greeter, everything else stays close-on-exec
+    const int childFd = fds[1];
+    m_process->setChildProcessModifier([childFd] {
+        ::fcntl(childFd, F_SETFD, 0);
+    });
+
+    QStringList arguments { QStringLiteral("--greeter"), QString::number(childFd) };
+    if (m_standby) {
+        arguments << QStringLiteral("--standby");
+    }
+
+    m_process->start(QCoreApplication::applicationFilePath(), arguments);
+    ::close(childFd);
+
+    if (!m_process->waitForStarted()) {
+        qWarning() << "Could not start greeter" << m_process->errorString();
+        ::close(fds[0]);
+        return false;
+    }
+
+    m_link = new GreeterLink(fds[0], this);
+    connect(m_link, &GreeterLink::messageReceived, this, &GreeterProcess::onMessage);
+    return true;
+}
+
+void GreeterProcess::send(const QByteArray &message)
+{
+    if (m_link) {
+        m_link->send(message);
+    }
+
+    if (message == "show") {
+        m_standby = false;
+    }
+}
+
+void GreeterProcess::sendInput(const SecureBuffer &text)
+{
+    if (m_link) {
+        m_link->sendInput(text);
+    }
+}
+
+void GreeterProcess::kill()
+{
+    m_process->kill();
+}
+
+void GreeterProcess::onMessage(const QByteArray &message)
+{
+    if (message == "ready") {
+        m_ready = true;
+        Q_EMIT ready();
+    } else if (message == "unlocked") {
+        // only trusted together with a clean exit of an active greeter
+        m_unlocked = !m_standby;
+        if (m_unlocked) {
+            Q_EMIT unlocked();
+        }
+    } else if (message == "pong") {
+        Q_EMIT pong();
+    } else if (message.startsWith("service ")) {
+        m_service = QString::fromLatin1(message.mid(8));
+    }
+}
+
+LockHolder::LockHolder(QObject *parent)
+    : QObject(parent)
+    , m_grabber(new InputGrabber(this))
+    , m_pingTimer(new QTimer(this))
+{
+    connect(m_grabber, &InputGrabber::secured, this, [this](qint64 elapsedNs) {
+        m_inputSecuredNs = elapsedNs;
+        Q_EMIT inputSecured(elapsedNs / 1000000.0);
+    });
+    connect(m_grabber, &InputGrabber::failed, this, &LockHolder::grabFailed);
+
+    m_pingTimer->setObjectName(QStringLiteral("greeterPingTimer"));
+    m_pingTimer->setInterval(s_pingInterval);
+    connect(m_pingTimer, &QTimer::timeout, this, &LockHolder::onPingTimeout);
+
+    connect(qGuiApp, &QGuiApplication::screenAdded, this, &LockHolder::updateCovers);
+    connect(qGuiApp, &QGuiApplication::screenRemoved, this, &LockHolder::updateCovers);
+}
+
+LockHolder::~LockHolder()
+{
+    delete m_spare;
+    delete m_active;
+    qDeleteAll(m_covers);
+}
+
+void LockHolder::start()
+{
+    updateCovers();
+    setGrabbed(true);
+
+    m_respawnTimer.start();
+    activate(new GreeterProcess(false, this));
+    startSpare();
+}
+
+QString LockHolder::greeterService() const
+{
+    return m_active ? m_active->service() : QString();
+}
+
+int LockHolder::greeterRestarts() const
+{
+    return m_restarts;
+}
+
+double LockHolder::lastRespawnLatency() const
+{
+    return m_lastRespawnNs < 0 ? -1.0 : m_lastRespawnNs / 1000000.0;
+}
+
+void LockHolder::restartGreeter()
+{
+    if (m_active) {
+        m_active->kill();
+    }
+}
+
+double LockHolder::inputSecuredTime() const
+{
+    return m_inputSecuredNs < 0 ? -1.0 : m_inputSecuredNs / 1000000.0;
+}
+
+bool LockHolder::isLockActive() const
+{
+    return m_lockActive;
+}
+
+void LockHolder::updateCovers()
+{
+    const QList<QScreen *> screens = QGuiApplication::screens();
+
+    while (m_covers.count() > screens.count()) {
+        delete m_covers.takeLast();
+    }
+
+    for (int i = m_covers.count(); i < screens.count(); ++i) {
+        auto *cover = new CoverWindow(screens.at(i));
+        connect(cover, &CoverWindow::exposed, this, &LockHolder::applyGrab);
+        connect(cover, &CoverWindow::keyPressed, this, [this](QKeyEvent *event) {
+            m_earlyInput.addKey(event);
+        });
+        m_covers << cover;
+    }
+
+    for (int i = 0; i < screens.count(); ++i) {
+        CoverWindow *cover = m_covers.at(i);
+        cover->setScreen(screens.at(i));
+        cover->setGeometry(screens.at(i)->geometry());
+        cover->showFullScreen();
+    }
+
+    applyGrab();
+}
+
+void LockHolder::setGrabbed(bool grabbed)
+{
+    m_grabbed = grabbed;
+    applyGrab();
+}
+
+void LockHolder::applyGrab()
+{
+    if (m_grabbed && !m_covers.isEmpty()) {
+        m_grabber->grab(m_covers.first());
+    } else {
+        m_grabber->release();
+    }
+}
+
+void LockHolder::setLockActive(bool active)
+{
+    if (m_lockActive == active) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    m_lockActive = active;
+    LOCKER_TRACE1(lock_active, int(active));
+    Q_EMIT lockActiveChanged(active, qlonglong(now.tv_sec) * 1000000 + now.tv_nsec / 1000);
+}
+
+void LockHolder::activate(GreeterProcess *greeter)
+{
+    m_active = greeter;
+    m_pongPending = false;
+
+    connect(greeter, &GreeterProcess::ready, this, &LockHolder::onActiveReady);
+    // the covers only go away once the greeter has exited, so this is still before
+    connect(greeter, &GreeterProcess::unlocked, this, [this] { setLockActive(false); });
+    connect(greeter, &GreeterProcess::pong, this, [this] { m_pongPending = false; });
+    connect(greeter, &GreeterProcess::finished, this, [this, greeter](int exitCode, QProcess::ExitStatus exitStatus) {
+        onGreeterFinished(greeter, exitCode, exitStatus);
+    });
+
+    // a standby greeter already runs, it only needs to show its views
+    if (greeter->pid() > 0) {
+        greeter->send("show");
+        return;
+    }
+
+    if (!greeter->start()) {
+        // keep the covers and the grab, try again shortly
+        QTimer::singleShot(1000, this, [this, greeter] {
+            if (m_active == greeter) {
+                onGreeterFinished(greeter, -1, QProcess::CrashExit);
+            }
+        });
+    }
+}
+
+void LockHolder::startSpare()
+{
+    auto *spare = new GreeterProcess(true, this);
+
+    connect(spare, &GreeterProcess::finished, this, [this, spare] {
+        if (m_spare != spare) {
+            return;
+        }
+
+        // the standby greeter died before being used, retry with a backoff
+        m_spare = nullptr;
+        spare->deleteLater();
+        m_spareBackoff = qBound(1000, m_spareBackoff * 2, s_maxSpareBackoff);
+        QTimer::singleShot(m_spareBackoff, this, [this] {
+            if (!m_spare) {
+                startSpare();
+            }
+        });
+    });
+
+    if (!spare->start()) {
+        delete spare;
+        return;
+    }
+
+    m_spare = spare;
+}
+
+void LockHolder::onActiveReady()
+{
+    if (m_respawnTimer.isValid()) {
+        m_lastRespawnNs = m_respawnTimer.nsecsElapsed();
+        m_respawnTimer.invalidate();
+        qInfo().nospace() << "Greeter " << m_active->pid() << " ready after " << m_lastRespawnNs / 1000000.0 << " ms";
+    }
+
+    if (!m_earlyInput.text().isEmpty()) {
+        m_active->sendInput(m_earlyInput.text());
+    }
+    if (m_earlyInput.submit()) {
+        m_active->send("submit");
+    }
+    m_earlyInput.clear();
+
+    // the greeter grabs input itself, which only works once we let go
+    setGrabbed(false);
+    m_active->send("grab");
+
+    m_spareBackoff = 0;
+    m_pingTimer->start();
+
+    // stays active while a crashed greeter is being replaced, the covers never left
+    setLockActive(true);
+}
+
+void LockHolder::onGreeterFinished(GreeterProcess *greeter, int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (greeter != m_active) {
+        return;
+    }
+
+    m_active = nullptr;
+    greeter->deleteLater();
+    m_pingTimer->stop();
+
+    if (greeter->hasUnlocked() && exitStatus == QProcess::NormalExit && exitCode == 0) {
+        delete m_spare;
+        m_spare = nullptr;
+        QCoreApplication::exit();
+        return;
+    }
+
+    qWarning() << "Greeter exited without unlocking, exit code" << exitCode << exitStatus;
+
+    setGrabbed(true);
+    ++m_restarts;
+    m_respawnTimer.start();
+
+    if (m_spare) {
+        GreeterProcess *spare = m_spare;
+        m_spare = nullptr;
+        activate(spare);
+        startSpare();
+    } else {
+        activate(new GreeterProcess(false, this));
+    }
+}
+
+void LockHolder::onPingTimeout()
+{
+    if (!m_active) {
+        return;
+    }
+
+    if (m_pongPending) {
+        qWarning() << "Greeter" << m_active->pid() << "stopped responding, replacing it";
+        m_active->kill();
+        return;
+    }
+
+    m_pongPending = true;
+    m_active->send("ping");
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCKHOLDER_H
+#define LOCKHOLDER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRasterWindow>
+
+#include "earlyinput.h"
+
+class GreeterLink;
+class InputGrabber;
+class QTimer;
+
+// Black window covering one screen while no greeter is shown
+class CoverWindow : public QRasterWindow
+{
+    Q_OBJECT
+
+public:
+    explicit CoverWindow(QScreen *screen);
+
+signals:
+    void exposed();
+    void keyPressed(QKeyEvent *event);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void exposeEvent(QExposeEvent *event) override;
+};
+
+// One greeter process, started from this executable with --greeter
+class GreeterProcess : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GreeterProcess(bool standby, QObject *parent = nullptr);
+    ~GreeterProcess() override;
+
+    bool start();
+    void send(const QByteArray &message);
+    void sendInput(const SecureBuffer &text);
+    void kill();
+
+    bool isReady() const { return m_ready; }
+    bool hasUnlocked() const { return m_unlocked; }
+    QString service() const { return m_service; }
+    qint64 pid() const { return m_process->processId(); }
+
+signals:
+    void ready();
+    void unlocked();
+    void finished(int exitCode, QProcess::ExitStatus exitStatus);
+    void pong();
+
+private:
+    void onMessage(const QByteArray &message);
+
+private:
+    QProcess *m_process;
+    GreeterLink *m_link = nullptr;
+    bool m_standby;
+    bool m_ready = false;
+    bool m_unlocked = false;
+    QString m_service;
+};
+
+// The lock holder owns the session lock: the D-Bus name, a black cover per
+// screen and the input grabs whenever no greeter has taken them over. The
+// greeter runs in a child process; a standby greeter is kept loaded with its
+// views hidden, so when the active one crashes or hangs it is replaced by
+// showing the standby instead of starting a new process from scratch. The
+// session stays locked until a greeter reports a successful unlock and then
+// exits cleanly.
+class LockHolder : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.cutefish.ScreenLocker")
+
+public:
+    explicit LockHolder(QObject *parent = nullptr);
+    ~LockHolder() override;
+
+    void start();
+
+public slots:
+    // D-Bus
+    Q_SCRIPTABLE QString greeterService() const;
+    Q_SCRIPTABLE int greeterRestarts() const;
+    Q_SCRIPTABLE double lastRespawnLatency() const;
+    Q_SCRIPTABLE void restartGreeter();
+    Q_SCRIPTABLE bool isLockActive() const;
+    Q_SCRIPTABLE double inputSecuredTime() const;
+
+signals:
+    // timestamp is CLOCK_MONOTONIC in microseconds
+    Q_SCRIPTABLE void lockActiveChanged(bool active, qlonglong timestamp);
+    Q_SCRIPTABLE void inputSecured(double ms);
+    Q_SCRIPTABLE void grabFailed(const QString &reason);
+
+private:
+    void updateCovers();
+    void setGrabbed(bool grabbed);
+    void applyGrab();
+    void setLockActive(bool active);
+
+    void activate(GreeterProcess *greeter);
+    void startSpare();
+    void onActiveReady();
+    void onGreeterFinished(GreeterProcess *greeter, int exitCode, QProcess::ExitStatus exitStatus);
+    void onPingTimeout();
+
+private:
+    QList<CoverWindow *> m_covers;
+    InputGrabber *m_grabber;
+    bool m_grabbed = false;
+    qint64 m_inputSecuredNs = -1;
+    bool m_lockActive = false;
+
+    // Typed while we hold the grab, handed to the greeter that takes it over
+    EarlyInput m_earlyInput;
+
+    GreeterProcess *m_active = nullptr;
+    GreeterProcess *m_spare = nullptr;
+    int m_spareBackoff = 0;
+
+    QTimer *m_pingTimer;
+    bool m_pongPending = false;
+
+    QElapsedTimer m_respawnTimer;
+    qint64 m_lastRespawnNs = -1;
+    int m_restarts = 0;
+};
+
+#endif // LOCKHOLDER_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "lockwatcher.h"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTimer>
+
+#include <stdio.h>
+#include <time.h>
+
+// how long a run with a budget waits for the lock to become active
+static const int s_timeoutMs = 30000;
+
+LockWatcher::LockWatcher(int budgetMs, QObject *parent)
+    : QObject(parent)
+    , m_budgetMs(budgetMs)
+{
+}
+
+bool LockWatcher::start()
+{
+    // only the owner of the name, in --split mode that is the lock holder
+    if (!QDBusConnection::sessionBus().connect(QStringLiteral("com.cutefish.ScreenLocker"),
+                                               QStringLiteral("/ScreenLocker"),
+                                               QStringLiteral("com.cutefish.ScreenLocker"),
+                                               QStringLiteral("lockActiveChanged"),
+                                               this,
+                                               SLOT(onLockActiveChanged(bool, qlonglong)))) {
+        return false;
+    }
+
+    m_clock.start();
+    if (m_budgetMs > 0) {
+        QTimer::singleShot(s_timeoutMs, this, [] {
+            printf("timeout\n");
+            fflush(stdout);
+            QCoreApplication::exit(2);
+        });
+    }
+
+    // the match is in place, a script can start the locker now
+    printf("ready\n");
+    fflush(stdout);
+    return true;
+}
+
+void LockWatcher::onLockActiveChanged(bool active, qlonglong timestamp)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const qlonglong handoffUs = qlonglong(now.tv_sec) * 1000000 + now.tv_nsec / 1000 - timestamp;
+
+    printf("active=%d handoff_us=%lld since_start_ms=%lld\n", int(active), handoffUs, static_cast<long long>(m_clock.elapsed()));
+    fflush(stdout);
+
+    if (m_budgetMs > 0 && active) {
+        QCoreApplication::exit(handoffUs <= qlonglong(m_budgetMs) * 1000 ? 0 : 1);
+    }
+}
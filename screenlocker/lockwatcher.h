@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LOCKWATCHER_H
+#define LOCKWATCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+// Reference client of lockActiveChanged (--watch-lock <budget ms>), what a
+// shell or dock would do to throttle itself while the lock is up. Prints
+// one line per change with the handoff delay, the time from the moment the
+// locker changed state to the moment the signal arrived here.
+//
+// With a budget it exits after the first activation: 0 when the handoff
+// stayed within the budget, 1 when it did not, 2 when no activation came.
+// With a budget of 0 it keeps watching.
+class LockWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LockWatcher(int budgetMs, QObject *parent = nullptr);
+
+    bool start();
+
+private slots:
+    void onLockActiveChanged(bool active, qlonglong timestamp);
+
+private:
+    int m_budgetMs;
+    QElapsedTimer m_clock;
+};
+
+#endif // LOCKWATCHER_H
@@ -18,20 +18,186 @@
  */
 
 #include "application.h"
+#include "dbusaudit.h"
+#include "inputgrabber.h"
+#include "lockholder.h"
+#include "lockwatcher.h"
+#include "pipelinecache.h"
+#include "replayharness.h"
+#include "soakrunner.h"
+#include "textwarmup.h"
+#include "wallpaperhandoff.h"
 #include <QDBusConnection>
 #include <QTranslator>
 #include <QLocale>
 #include <QFile>  // 添加 QFile 头文件
 
+// --split: this process only holds the lock, the greeter runs as a child
+static int runLockHolder(int &argc, char **argv)
+{
+    QGuiApplication app(argc, argv);
+    app.setQuitOnLastWindowClosed(false);
+
+    LockHolder holder;
+
+    // waited for on purpose: a second locker must leave before any cover or grab
+    if (!DBusAudit::registerService(QDBusConnection::sessionBus(), QStringLiteral("com.cutefish.ScreenLocker"), "runLockHolder")) {
+        return -1;
+    }
+
+    if (!QDBusConnection::sessionBus().registerObject("/ScreenLocker", &holder, QDBusConnection::ExportScriptableContents)) {
+        return -1;
+    }
+
+    holder.start();
+    return app.exec();
+}
+
+// --publish-wallpaper: stand-in for the desktop shell side of the wallpaper handoff
+static int runWallpaperPublisher(int &argc, char **argv, const QString &fileName)
+{
+    QCoreApplication app(argc, argv);
+
+    WallpaperPublisher publisher(fileName);
+    if (!publisher.registerService()) {
+        return -1;
+    }
+
+    return app.exec();
+}
+
+// --watch-lock: stand-in for a desktop component throttling itself while locked
+static int runLockWatcher(int &argc, char **argv, int budgetMs)
+{
+    QCoreApplication app(argc, argv);
+
+    LockWatcher watcher(budgetMs);
+    if (!watcher.start()) {
+        return -1;
+    }
+
+    return app.exec();
+}
+
 int main(int argc, char *argv[])
 {
+    bool split = false;
+    bool standby = false;
+    int holderFd = -1;
+    QString replayFile;
+    QString replayReport;
+    double soakHours = 0;
+    QString soakReport;
+    int checkPassFd = -1;
+    int soakHolderFd = -1;
+    int holdGrabMs = -1;
+    QString publishWallpaper;
+    int watchLockBudgetMs = -1;
+    bool warmCaches = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--split") == 0) {
+            split = true;
+        } else if (qstrcmp(argv[i], "--greeter") == 0 && i + 1 < argc) {
+            holderFd = QByteArray(argv[++i]).toInt();
+        } else if (qstrcmp(argv[i], "--standby") == 0) {
+            standby = true;
+        } else if (qstrcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayFile = QString::fromLocal8Bit(argv[++i]);
+        } else if (qstrcmp(argv[i], "--replay-report") == 0 && i + 1 < argc) {
+            replayReport = QString::fromLocal8Bit(argv[++i]);
+        } else if (qstrcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            soakHours = QByteArray(argv[++i]).toDouble();
+        } else if (qstrcmp(argv[i], "--soak-report") == 0 && i + 1 < argc) {
+            soakReport = QString::fromLocal8Bit(argv[++i]);
+        } else if (qstrcmp(argv[i], "--soak-holder") == 0 && i + 1 < argc) {
+            soakHolderFd = QByteArray(argv[++i]).toInt();
+        } else if (qstrcmp(argv[i], "--hold-grab") == 0 && i + 1 < argc) {
+            holdGrabMs = QByteArray(argv[++i]).toInt();
+        } else if (qstrcmp(argv[i], "--publish-wallpaper") == 0 && i + 1 < argc) {
+            publishWallpaper = QString::fromLocal8Bit(argv[++i]);
+        } else if (qstrcmp(argv[i], "--watch-lock") == 0 && i + 1 < argc) {
+            watchLockBudgetMs = QByteArray(argv[++i]).toInt();
+        } else if (qstrcmp(argv[i], "--warm-caches") == 0) {
+            warmCaches = true;
+        } else if (qstrcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            checkPassFd = QByteArray(argv[++i]).toInt();
+        }
+    }
+
+    // started by a soak run in place of ccheckpass
+    if (checkPassFd >= 0 && qEnvironmentVariableIsSet("CUTEFISH_SCREENLOCKER_FAKE_CHECKPASS")) {
+        return SoakRunner::runFakeCheckPass(checkPassFd);
+    }
+
+    // started by a soak run in place of the lock holder
+    if (soakHolderFd >= 0) {
+        return SoakRunner::runHolderStandIn(argc, argv, soakHolderFd);
+    }
+
+    if (holdGrabMs >= 0) {
+        return InputGrabber::holdCompetingGrab(holdGrabMs);
+    }
+
+    if (!publishWallpaper.isEmpty()) {
+        return runWallpaperPublisher(argc, argv, publishWallpaper);
+    }
+
+    if (watchLockBudgetMs >= 0) {
+        return runLockWatcher(argc, argv, watchLockBudgetMs);
+    }
+
+    if (split) {
+        return runLockHolder(argc, argv);
+    }
+
+    if (!replayFile.isEmpty() || soakHours > 0) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     Application app(argc, argv);
 
-    if (!QDBusConnection::sessionBus().registerService("com.cutefish.ScreenLocker")) {
+    if (warmCaches) {
+        // fontconfig writes its cache for any font directory it had to scan
+        TextWarmup::run(TextWarmup::lockScreenText(QString()));
+        return PipelineCache::warm();
+    }
+
+    if (!replayFile.isEmpty()) {
+        // no service name, a replay can run next to a real locker
+        ReplayHarness harness(&app, replayFile, replayReport);
+        if (!harness.load()) {
+            return -1;
+        }
+
+        app.setTesting(true);
+        app.setQuitOnLastWindowClosed(false);
+        app.setFakeScreens(harness.initialScreens());
+        app.initialViewSetup();
+        harness.start();
+        return app.exec();
+    }
+
+    if (soakHours > 0) {
+        SoakRunner runner(&app, soakHours, soakReport);
+
+        app.setTesting(true);
+        app.setQuitOnLastWindowClosed(false);
+        app.setFakeScreens({ QRect(0, 0, 1920, 1080) });
+        app.initialViewSetup();
+        runner.start();
+        return app.exec();
+    }
+
+    if (holderFd >= 0) {
+        // the holder owns the service name, we are reachable by our unique name
+        app.setHolderLink(holderFd, standby);
+    } else if (!DBusAudit::registerService(QDBusConnection::sessionBus(), QStringLiteral("com.cutefish.ScreenLocker"), "main")) {
+        // waited for on purpose: a second locker must leave before any view or grab
         return -1;
     }
 
-    if (!QDBusConnection::sessionBus().registerObject("/ScreenLocker", &app)) {
+    if (!QDBusConnection::sessionBus().registerObject("/ScreenLocker", &app, QDBusConnection::ExportScriptableContents)) {
         return -1;
     }
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "passwordmodel.h"
+
+PasswordModel::PasswordModel(QObject *parent)
+    : QObject(parent)
+{
+}
+
+bool PasswordModel::replaceSelection()
+{
+    if (!m_selected) {
+        return false;
+    }
+
+    m_selected = false;
+    m_buffer.clear();
+    return true;
+}
+
+void PasswordModel::insert(QStringView text, int count)
+{
+    replaceSelection();
+    while (count-- > 0 && m_buffer.append(text)) {
+    }
+    Q_EMIT changed();
+}
+
+void PasswordModel::insert(const SecureBuffer &text)
+{
+    replaceSelection();
+    m_buffer.append(text);
+    Q_EMIT changed();
+}
+
+void PasswordModel::backspace(int count)
+{
+    // a selected password goes away as a whole
+    if (replaceSelection()) {
+        --count;
+    }
+    m_buffer.chop(count);
+    Q_EMIT changed();
+}
+
+void PasswordModel::clear()
+{
+    m_selected = false;
+    m_buffer.clear();
+    Q_EMIT changed();
+}
+
+void PasswordModel::selectAll()
+{
+    if (m_selected || m_buffer.isEmpty()) {
+        return;
+    }
+
+    m_selected = true;
+    Q_EMIT changed();
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASSWORDMODEL_H
+#define PASSWORDMODEL_H
+
+#include <QObject>
+
+#include "securebuffer.h"
+
+// The password being typed, one for the lock screens of all screens. Keys
+// are applied here by Application before they reach QML; the password
+// fields only show as many dots as there are characters, so the text never
+// exists as a QString. After a failed attempt the whole password is
+// selected and the next character replaces it.
+class PasswordModel : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int length READ length NOTIFY changed)
+    Q_PROPERTY(bool selected READ isSelected NOTIFY changed)
+
+public:
+    explicit PasswordModel(QObject *parent = nullptr);
+
+    int length() const { return m_buffer.length(); }
+    bool isSelected() const { return m_selected; }
+    bool isEmpty() const { return m_buffer.isEmpty(); }
+
+    const SecureBuffer &buffer() const { return m_buffer; }
+
+    void insert(QStringView text, int count = 1);
+    void insert(const SecureBuffer &text);
+    void backspace(int count = 1);
+
+public slots:
+    void clear();
+    void selectAll();
+
+signals:
+    void changed();
+
+private:
+    bool replaceSelection();
+
+private:
+    SecureBuffer m_buffer;
+    bool m_selected = false;
+};
+
+#endif // PASSWORDMODEL_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pipelinecache.h"
+#include "application.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QSaveFile>
+#include <QScreen>
+#include <QStandardPaths>
+#include <QThread>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+#include <QQuickGraphicsConfiguration>
+#endif
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+#include <QQuickRenderControl>
+#include <QQuickRenderTarget>
+#include <rhi/qrhi.h>
+
+#include <memory>
+#endif
+
+// Enough for the blur animation and the first image loads to show up
+static const int s_warmFrames = 30;
+
+QString PipelineCache::location()
+{
+    static const QString s_directory = [] {
+        const QString root = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                             + QStringLiteral("/cutefish-screenlocker/pipelines");
+
+        // a new Qt, graphics API or locker build starts over
+        const QFileInfo executable(QCoreApplication::applicationFilePath());
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(qVersion());
+        hash.addData(QByteArray::number(int(QQuickWindow::graphicsApi())));
+        hash.addData(QByteArray::number(executable.size()));
+        hash.addData(QByteArray::number(executable.lastModified().toMSecsSinceEpoch()));
+        const QString key = QString::fromLatin1(hash.result().toHex().left(16));
+
+        QDir dir(root);
+        const QStringList stale = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &entry : stale) {
+            if (entry != key) {
+                QDir(dir.filePath(entry)).removeRecursively();
+            }
+        }
+        dir.mkpath(key);
+
+        return dir.filePath(key);
+    }();
+
+    return s_directory;
+}
+
+QString PipelineCache::fileName(int index)
+{
+    return location() + QStringLiteral("/view-%1.bin").arg(index);
+}
+
+bool PipelineCache::isWarm(int index)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    return QFileInfo(fileName(index)).size() > 0;
+#else
+    Q_UNUSED(index)
+    return false;
+#endif
+}
+
+void PipelineCache::configure(QQuickWindow *view, int index)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    const QString file = fileName(index);
+
+    QQuickGraphicsConfiguration config = view->graphicsConfiguration();
+    if (isWarm(index)) {
+        config.setPipelineCacheLoadFile(file);
+    }
+    // written when the view goes away at unlock
+    config.setPipelineCacheSaveFile(file);
+    view->setGraphicsConfiguration(config);
+#else
+    Q_UNUSED(view)
+    Q_UNUSED(index)
+#endif
+}
+
+int PipelineCache::warm()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    auto *app = qobject_cast<Application *>(QCoreApplication::instance());
+    if (!app) {
+        return 1;
+    }
+
+    for (int i = 0; i < app->screens().count(); ++i) {
+        const QSize size = app->screens().at(i)->size();
+
+        QQuickRenderControl control;
+        QQuickWindow window(&control);
+        configure(&window, i);
+        window.resize(size);
+
+        QQmlEngine engine;
+        app->prepareEngine(&engine, &window, i);
+
+        QQmlComponent component(&engine, QUrl(QStringLiteral("qrc:/qml/LockScreen.qml")));
+        std::unique_ptr<QQuickItem> root(qobject_cast<QQuickItem *>(component.create()));
+        if (!root) {
+            qWarning() << "Could not load the lock screen" << component.errors();
+            return 1;
+        }
+        root->setSize(size);
+        root->setParentItem(window.contentItem());
+
+        if (!control.initialize()) {
+            qWarning() << "No graphics for warming the pipeline cache";
+            return 1;
+        }
+
+        // the pipelines depend on the render target format, not its size
+        QRhi *rhi = control.rhi();
+        std::unique_ptr<QRhiTexture> texture(rhi->newTexture(QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget));
+        std::unique_ptr<QRhiRenderBuffer> depthStencil(rhi->newRenderBuffer(QRhiRenderBuffer::DepthStencil, size, 1));
+        if (!texture->create() || !depthStencil->create()) {
+            return 1;
+        }
+
+        QRhiTextureRenderTargetDescription description { QRhiColorAttachment(texture.get()) };
+        description.setDepthStencilBuffer(depthStencil.get());
+        std::unique_ptr<QRhiTextureRenderTarget> target(rhi->newTextureRenderTarget(description));
+        std::unique_ptr<QRhiRenderPassDescriptor> renderPass(target->newCompatibleRenderPassDescriptor());
+        target->setRenderPassDescriptor(renderPass.get());
+        if (!target->create()) {
+            return 1;
+        }
+        window.setRenderTarget(QQuickRenderTarget::fromRhiRenderTarget(target.get()));
+
+        for (int frame = 0; frame < s_warmFrames; ++frame) {
+            // image loads and animations move on between frames
+            QCoreApplication::processEvents();
+            QThread::msleep(16);
+
+            control.polishItems();
+            control.beginFrame();
+            control.sync();
+            control.render();
+            control.endFrame();
+        }
+
+        QSaveFile file(fileName(i));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(rhi->pipelineCacheData());
+            file.commit();
+        }
+
+        root.reset();
+    }
+
+    return 0;
+#else
+    qWarning() << "Pipeline caches need Qt 6.6 for warming";
+    return 1;
+#endif
+}
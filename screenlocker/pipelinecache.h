@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include <QString>
+
+class QQuickWindow;
+
+// On-disk graphics pipeline cache of the lock screen views (Qt >= 6.5), so
+// a new lock does not compile every shader pipeline again. Caches live in
+// ~/.cache/cutefish-screenlocker/pipelines/<key>, where the key covers the
+// Qt version, the graphics API and this executable; caches under any other
+// key are removed. The RHI itself rejects data of another driver or device.
+class PipelineCache
+{
+public:
+    // Before the view is first exposed
+    static void configure(QQuickWindow *view, int index);
+
+    // Whether the view starts with a cache from an earlier lock
+    static bool isWarm(int index);
+
+    // --warm-caches: renders the lock screen offscreen once per screen and
+    // saves the caches, for running at install or login time
+    static int warm();
+
+    static QString location();
+
+private:
+    static QString fileName(int index);
+};
+
+#endif // PIPELINECACHE_H
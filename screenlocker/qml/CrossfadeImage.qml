@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+import QtQuick 6.0
+
+// Loads a new source in the background and fades it in over the
+// old one once it is ready, then drops the old one.
+Item {
+    id: control
+
+    property url source
+    property int fillMode: Image.Stretch
+    property int duration: 300
+
+    // the first image is fully shown
+    signal shown()
+
+    property Image _current: null
+    property Image _previous: null
+
+    onSourceChanged: {
+        var next = _current === _imageA ? _imageB : _imageA
+        next.source = source
+    }
+
+    function _show(image) {
+        _previous = _current
+        _current = image
+        _fadeIn.restart()
+    }
+
+    NumberAnimation {
+        id: _fadeIn
+        target: control._current
+        property: "opacity"
+        from: 0
+        to: 1
+        duration: control.duration
+
+        onFinished: {
+            if (control._previous) {
+                control._previous.source = ""
+                control._previous = null
+            } else {
+                control.shown()
+            }
+        }
+    }
+
+    Image {
+        id: _imageA
+        anchors.fill: parent
+        fillMode: control.fillMode
+        sourceSize: Qt.size(width, height)
+        asynchronous: true
+        cache: false
+        smooth: true
+        opacity: 0
+        z: control._current === _imageA ? 1 : 0
+        visible: control._current === _imageA || control._previous === _imageA
+
+        onStatusChanged: if (status === Image.Ready && control._current !== _imageA) control._show(_imageA)
+    }
+
+    Image {
+        id: _imageB
+        anchors.fill: parent
+        fillMode: control.fillMode
+        sourceSize: Qt.size(width, height)
+        asynchronous: true
+        cache: false
+        smooth: true
+        opacity: 0
+        z: control._current === _imageB ? 1 : 0
+        visible: control._current === _imageB || control._previous === _imageB
+
+        onStatusChanged: if (status === Image.Ready && control._current !== _imageB) control._show(_imageB)
+    }
+}
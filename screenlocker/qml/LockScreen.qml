@@ -23,7 +23,6 @@ import QtQuick.Controls 6.0
 import QtQuick.Layouts 6.0
 import Qt5Compat.GraphicalEffects 6.0
 
-import cutefish.accounts 1.0 as Accounts
 import cutefish.system 1.0 as System
 import FishUI 1.0 as FishUI
 
@@ -32,21 +31,47 @@ Item {
 
     property string notification
 
+    // The wallpaper shown when the lock started, blurred in the view unless
+    // this is the lite scene. Later changes arrive blurred already and fade
+    // in above it. "%1" stands for the variant.
+    property string baseWallpaper
+
     LayoutMirroring.enabled: Qt.locale().textDirection === Qt.RightToLeft
     LayoutMirroring.childrenInherit: true
 
     System.Wallpaper {
         id: wallpaper
+        onPathChanged: wallpaperPyramid.setPath(path)
+    }
+
+    Connections {
+        target: wallpaperPyramid
+
+        function onRevisionChanged() {
+            if (!root.baseWallpaper) {
+                root.baseWallpaper = root.wallpaperSource("%1")
+            } else if (!desktopBackground) {
+                wallpaperUpdate.source = root.wallpaperSource("blurred")
+            }
+        }
+    }
+
+    function wallpaperSource(variant) {
+        return "image://wallpaper/" + wallpaperPyramid.revision + "/" + variant + wallpaperPyramid.path
     }
 
     Image {
         id: wallpaperImage
         anchors.fill: parent
-        source: "file://" + wallpaper.path
-        sourceSize: Qt.size(width * Screen.devicePixelRatio,
-                            height * Screen.devicePixelRatio)
+        // decoded once for all screens, see WallpaperPyramid, unless the
+        // frozen desktop was asked for
+        source: desktopBackground ? desktopBackground
+                                  : root.baseWallpaper ? root.baseWallpaper.arg(liteScene ? "blurred" : "plain") : ""
+        // image providers get sourceSize scaled by the device pixel ratio
+        sourceSize: Qt.size(width, height)
         fillMode: Image.PreserveAspectCrop
-        asynchronous: false
+        // the provider may wait for a handoff from the desktop shell
+        asynchronous: true
         clip: true
         cache: false
         smooth: true
@@ -58,7 +83,21 @@ Item {
         radius: 0
         source: wallpaperImage
         cached: true
-        visible: true
+        // the frozen desktop and the lite scene come blurred already
+        visible: !desktopBackground && !liteScene
+    }
+
+    CrossfadeImage {
+        id: wallpaperUpdate
+        anchors.fill: parent
+        visible: !desktopBackground
+        duration: liteScene ? 0 : 300
+
+        // nothing left to see below, stop blurring it
+        onShown: {
+            wallpaperImage.source = ""
+            wallpaperBlur.visible = false
+        }
     }
 
     NumberAnimation {
@@ -70,11 +109,8 @@ Item {
         to: 64
     }
 
-    Accounts.UserAccount {
-        id: currentUser
-    }
-
     Timer {
+        objectName: "clockTimer"
         repeat: true
         running: true
         interval: 1000
@@ -89,7 +125,15 @@ Item {
         timeLabel.updateInfo()
         dateLabel.updateInfo()
 
-        blurAni.start()
+        // a view added later starts from whatever is shown by then
+        wallpaperPyramid.setPath(wallpaper.path)
+        if (!root.baseWallpaper && wallpaperPyramid.revision > 0) {
+            root.baseWallpaper = root.wallpaperSource("%1")
+        }
+
+        if (!liteScene) {
+            blurAni.start()
+        }
     }
 
     Item {
@@ -150,7 +194,7 @@ Item {
             spread: 0.35
             color: Qt.rgba(0, 0, 0, 0.8)
             opacity: 0.1
-            visible: true
+            visible: !liteScene
         }
 
         DropShadow {
@@ -164,7 +208,7 @@ Item {
             spread: 0.35
             color: Qt.rgba(0, 0, 0, 0.8)
             opacity: 0.1
-            visible: true
+            visible: !liteScene
         }
     }
 
@@ -192,31 +236,21 @@ Item {
             Image {
                 id: userIcon
 
+                // Must match UserInfo::AvatarSize
                 property int iconSize: 60
 
                 Layout.preferredHeight: iconSize
                 Layout.preferredWidth: iconSize
-                sourceSize: String(source) === "image://icontheme/default-user" ? Qt.size(iconSize, iconSize) : undefined
-                source: currentUser.iconFileName ? "file:///" + currentUser.iconFileName : "image://icontheme/default-user"
+                sourceSize: Qt.size(iconSize, iconSize)
+                // The avatar comes pre-cropped and circle-masked for this ratio
+                source: userInfo.hasAvatar ? "image://useravatar/" + userInfo.avatarRevision + "/" + Screen.devicePixelRatio
+                                           : "image://icontheme/default-user"
                 Layout.alignment: Qt.AlignHCenter
-
-                layer.enabled: true
-                layer.effect: OpacityMask {
-                    maskSource: Item {
-                        width: userIcon.width
-                        height: userIcon.height
-
-                        Rectangle {
-                            anchors.fill: parent
-                            radius: parent.height / 2
-                        }
-                    }
-                }
             }
 
             Label {
                 Layout.alignment: Qt.AlignHCenter
-                text: currentUser.userName
+                text: userInfo.userName
             }
 
             Item {
@@ -225,16 +259,78 @@ Item {
 
             TextField {
                 id: password
+                objectName: "passwordField"
                 Layout.alignment: Qt.AlignHCenter
                 Layout.preferredHeight: 36
                 Layout.fillWidth: true
-                placeholderText: qsTr("Password")
                 leftPadding: FishUI.Units.largeSpacing
                 rightPadding: 36 + FishUI.Units.largeSpacing //FishUI.Units.largeSpacing
                 enabled: !authenticator.graceLocked
                 focus: true
 
-                echoMode: TextInput.Password
+                // Application puts the typed text into authenticator.password,
+                // the field itself stays empty and only shows the length. A
+                // keystroke changes one width below and nothing else, so
+                // typing neither lays out text nor creates items. Pasted and
+                // input method text is taken by Application too.
+                readOnly: true
+                cursorVisible: false
+                inputMethodHints: Qt.ImhHiddenText | Qt.ImhSensitiveData | Qt.ImhNoPredictiveText | Qt.ImhNoAutoUppercase
+
+                Label {
+                    anchors.fill: parent
+                    leftPadding: password.leftPadding
+                    rightPadding: password.rightPadding
+                    verticalAlignment: Text.AlignVCenter
+                    elide: Text.ElideRight
+                    text: qsTr("Password")
+                    color: password.placeholderTextColor
+                    visible: !authenticator.password.length
+                }
+
+                Item {
+                    id: passwordDots
+                    x: password.leftPadding
+                    anchors.verticalCenter: parent.verticalCenter
+                    width: Math.min(authenticator.password.length, dotRepeater.count) * (dotRow.dotSize + dotRow.spacing)
+                    height: dotRow.dotSize + 4
+                    clip: true
+
+                    Rectangle {
+                        anchors.fill: parent
+                        color: password.selectionColor
+                        visible: authenticator.password.selected
+                    }
+
+                    Row {
+                        id: dotRow
+                        property int dotSize: 7
+                        anchors.verticalCenter: parent.verticalCenter
+                        spacing: 3
+
+                        // created once, as many as fit into the field
+                        Repeater {
+                            id: dotRepeater
+                            model: 40
+
+                            Rectangle {
+                                width: dotRow.dotSize
+                                height: dotRow.dotSize
+                                radius: width / 2
+                                color: password.color
+                            }
+                        }
+                    }
+                }
+
+                Rectangle {
+                    x: passwordDots.x + passwordDots.width
+                    anchors.verticalCenter: parent.verticalCenter
+                    width: 1
+                    height: 16
+                    color: password.color
+                    visible: password.activeFocus && !authenticator.password.selected
+                }
 
                 background: Rectangle {
                     color: FishUI.Theme.darkMode ? "#B6B6B6" : "white"
@@ -244,13 +340,13 @@ Item {
 
                 Keys.onEnterPressed: root.tryUnlock()
                 Keys.onReturnPressed: root.tryUnlock()
-                Keys.onEscapePressed: password.text = ""
+                Keys.onEscapePressed: authenticator.password.clear()
 
                 LoginButton {
                     anchors.right: password.right
                     anchors.top: password.top
                     anchors.bottom: password.bottom
-                    source: "qrc:/images/screensaver-unlock-symbolic.svg"
+                    source: "image://icons/screensaver-unlock-symbolic"
                     iconMargins: 10
                     Layout.alignment: Qt.AlignHCenter
                     enabled: !authenticator.graceLocked
@@ -260,7 +356,7 @@ Item {
                     Layout.preferredWidth: 36
                 }
 
-                layer.enabled: true
+                layer.enabled: !liteScene
                 layer.effect: OpacityMask {
                     maskSource: Item {
                         width: password.width
@@ -287,7 +383,9 @@ Item {
         anchors.horizontalCenter: parent.horizontalCenter
         font.bold: true
         color: "white"
-        text: root.notification
+        // a lockout outlasts any other notification
+        text: authenticator.lockoutRemaining > 0 ? root.lockoutText(authenticator.lockoutRemaining)
+                                                 : root.notification
 
         Behavior on opacity {
             NumberAnimation {
@@ -309,7 +407,7 @@ Item {
         spread: 0.35
         color: Qt.rgba(0, 0, 0, 0.8)
         opacity: 0.3
-        visible: true
+        visible: !liteScene
     }
 
     Item {
@@ -327,18 +425,35 @@ Item {
         }
     }
 
+    Label {
+        anchors.left: parent.left
+        anchors.top: parent.top
+        anchors.margins: FishUI.Units.largeSpacing
+        visible: frameStats.enabled
+        text: frameStats.summary
+        font.family: "monospace"
+        color: "white"
+    }
+
+    function lockoutText(seconds) {
+        var minutes = Math.floor(seconds / 60)
+        var rest = seconds % 60
+        return qsTr("Too many failed attempts, try again in %1:%2").arg(minutes).arg(String(rest).padStart(2, "0"))
+    }
+
     function tryUnlock() {
-        if (!password.text) {
+        if (!authenticator.password.length) {
             notificationResetTimer.start()
             root.notification = qsTr("Please enter your password")
             return
         }
 
-        authenticator.tryUnlock(password.text)
+        authenticator.tryUnlock()
     }
 
     Timer {
         id: notificationResetTimer
+        objectName: "notificationResetTimer"
         interval: 3000
         onTriggered: root.notification = ""
     }
@@ -354,7 +469,7 @@ Item {
         function onGraceLockedChanged() {
             if (!authenticator.graceLocked) {
                 root.notification = ""
-                password.selectAll()
+                authenticator.password.selectAll()
                 password.focus = true
             }
         }
@@ -33,6 +33,8 @@ Item {
     property var artUrlTag: "mpris:artUrl"
     property var titleTag: "xesam:title"
     property var artistTag: "xesam:artist"
+    // one place that follows the theme, the buttons only append their icon
+    readonly property string iconPrefix: FishUI.Theme.darkMode ? "image://icons/dark/" : "image://icons/light/"
 
     MprisManager {
         id: mprisManager
@@ -75,11 +77,11 @@ Item {
             id: defaultImage
             width: _mainLayout.height
             height: width
-            source: "qrc:/images/media-cover.svg"
+            source: "image://icons/media-cover"
             sourceSize: Qt.size(width, height)
             visible: !artImage.visible
 
-            layer.enabled: true
+            layer.enabled: !liteScene
             layer.effect: OpacityMask {
                 maskSource: Item {
                     width: defaultImage.width
@@ -101,7 +103,7 @@ Item {
             // sourceSize: Qt.size(width, height)
             fillMode: Image.PreserveAspectFit
 
-            layer.enabled: true
+            layer.enabled: !liteScene
             layer.effect: OpacityMask {
                 maskSource: Item {
                     width: artImage.width
@@ -159,7 +161,7 @@ Item {
                 IconButton {
                     width: 30
                     height: 30
-                    source: "qrc:/images/" + (FishUI.Theme.darkMode ? "dark" : "light") + "/media-skip-backward-symbolic.svg"
+                    source: control.iconPrefix + "media-skip-backward-symbolic"
                     onLeftButtonClicked: if (mprisManager.canGoPrevious) mprisManager.previous()
                     visible: mprisManager.canGoPrevious
                     Layout.alignment: Qt.AlignRight
@@ -168,8 +170,7 @@ Item {
                 IconButton {
                     width: 30
                     height: 30
-                    source: control.isPlaying ? "qrc:/images/" + (FishUI.Theme.darkMode ? "dark" : "light") + "/media-playback-pause-symbolic.svg"
-                                              : "qrc:/images/" + (FishUI.Theme.darkMode ? "dark" : "light") + "/media-playback-start-symbolic.svg"
+                    source: control.iconPrefix + (control.isPlaying ? "media-playback-pause-symbolic" : "media-playback-start-symbolic")
                     Layout.alignment: Qt.AlignRight
                     visible: mprisManager.canPause || mprisManager.canPlay
                     onLeftButtonClicked:
@@ -181,7 +182,7 @@ Item {
                 IconButton {
                     width: 30
                     height: 30
-                    source: "qrc:/images/" + (FishUI.Theme.darkMode ? "dark" : "light") + "/media-skip-forward-symbolic.svg"
+                    source: control.iconPrefix + "media-skip-forward-symbolic"
                     Layout.alignment: Qt.AlignRight
                     visible: mprisManager.canGoNext
                     onLeftButtonClicked: if (mprisManager.canGoNext) mprisManager.next()
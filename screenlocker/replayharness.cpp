@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replayharness.h"
+#include "alloccounter.h"
+#include "application.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QQuickView>
+#include <QTimer>
+
+#include <stdio.h>
+
+// Typed keys that may still allocate: glyphs, caches and pools filling up
+static const int s_warmupKeys = 20;
+
+static QJsonArray rectToJson(const QRect &rect)
+{
+    return QJsonArray { rect.x(), rect.y(), rect.width(), rect.height() };
+}
+
+static QRect rectFromJson(const QJsonValue &value)
+{
+    const QJsonArray array = value.toArray();
+    return QRect(array.at(0).toInt(), array.at(1).toInt(), array.at(2).toInt(), array.at(3).toInt());
+}
+
+EventRecorder::EventRecorder(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_file(fileName)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open event recording" << fileName;
+    }
+
+    m_clock.start();
+}
+
+void EventRecorder::recordEvent(int viewIndex, QEvent *event)
+{
+    QJsonObject record;
+
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease: {
+        auto *ke = static_cast<QKeyEvent *>(event);
+        const bool printable = !ke->text().isEmpty() && ke->text().at(0).isPrint();
+
+        record.insert(QStringLiteral("type"), QStringLiteral("key"));
+        record.insert(QStringLiteral("press"), event->type() == QEvent::KeyPress);
+        record.insert(QStringLiteral("key"), printable ? int(Qt::Key_X) : ke->key());
+        record.insert(QStringLiteral("modifiers"), int(ke->modifiers()));
+        record.insert(QStringLiteral("text"), printable ? QStringLiteral("x") : ke->text());
+        record.insert(QStringLiteral("autoRepeat"), ke->isAutoRepeat());
+        break;
+    }
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseMove: {
+        auto *me = static_cast<QMouseEvent *>(event);
+
+        record.insert(QStringLiteral("type"), QStringLiteral("mouse"));
+        record.insert(QStringLiteral("event"), int(event->type()));
+        record.insert(QStringLiteral("x"), me->position().x());
+        record.insert(QStringLiteral("y"), me->position().y());
+        record.insert(QStringLiteral("button"), int(me->button()));
+        record.insert(QStringLiteral("buttons"), int(me->buttons()));
+        record.insert(QStringLiteral("modifiers"), int(me->modifiers()));
+        break;
+    }
+    default:
+        return;
+    }
+
+    record.insert(QStringLiteral("view"), viewIndex);
+    write(record);
+}
+
+void EventRecorder::recordScreens(const QList<QRect> &geometries)
+{
+    QJsonArray screens;
+    for (const QRect &geometry : geometries) {
+        screens.append(rectToJson(geometry));
+    }
+
+    QJsonObject record;
+    record.insert(QStringLiteral("type"), QStringLiteral("screens"));
+    record.insert(QStringLiteral("screens"), screens);
+    write(record);
+}
+
+void EventRecorder::recordGeometry(int screenIndex, const QRect &geometry)
+{
+    QJsonObject record;
+    record.insert(QStringLiteral("type"), QStringLiteral("geometry"));
+    record.insert(QStringLiteral("screen"), screenIndex);
+    record.insert(QStringLiteral("geometry"), rectToJson(geometry));
+    write(record);
+}
+
+void EventRecorder::write(QJsonObject record)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    record.insert(QStringLiteral("time"), m_clock.elapsed());
+    m_file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+    m_file.flush();
+}
+
+ReplayHarness::ReplayHarness(Application *app, const QString &fileName, const QString &reportFile, QObject *parent)
+    : QObject(parent)
+    , m_app(app)
+    , m_fileName(fileName)
+    , m_reportFile(reportFile)
+{
+    bool ok = false;
+    const int budgetUs = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_REPLAY_BUDGET_US", &ok);
+    if (ok && budgetUs > 0) {
+        m_budgetNs = qint64(budgetUs) * 1000;
+    }
+
+    const int keyAllocs = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_REPLAY_KEY_ALLOCS", &ok);
+    if (ok && keyAllocs > 0) {
+        m_typingAllocBudget = keyAllocs;
+    }
+}
+
+bool ReplayHarness::load()
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open recording" << m_fileName;
+        return false;
+    }
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        const QJsonDocument document = QJsonDocument::fromJson(line);
+        if (!document.isObject()) {
+            qWarning() << "Invalid record in" << m_fileName << line;
+            return false;
+        }
+        m_records << document.object();
+    }
+
+    return true;
+}
+
+QList<QRect> ReplayHarness::initialScreens() const
+{
+    QList<QRect> geometries;
+
+    for (const QJsonObject &record : m_records) {
+        if (record.value(QStringLiteral("type")).toString() == QLatin1String("screens")) {
+            for (const QJsonValue &screen : record.value(QStringLiteral("screens")).toArray()) {
+                geometries << rectFromJson(screen);
+            }
+            break;
+        }
+    }
+
+    if (geometries.isEmpty()) {
+        geometries << QRect(0, 0, 1920, 1080);
+    }
+
+    return geometries;
+}
+
+void ReplayHarness::start()
+{
+    // let the views load and present once before the first record
+    QTimer::singleShot(0, this, &ReplayHarness::replayNext);
+}
+
+void ReplayHarness::replayNext()
+{
+    // everything since the previous record returned to the event loop is its frame
+    AllocCounter::setPhase(AllocCounter::Idle);
+    const quint64 frameAllocs = AllocCounter::count(AllocCounter::Frame) - m_frameAllocs;
+    if (!m_lastType.isEmpty()) {
+        m_costs[m_lastType].frameAllocs += frameAllocs;
+        if (m_lastTyped) {
+            m_typingFrameAllocs += frameAllocs;
+        }
+    }
+
+    if (m_next >= m_records.count()) {
+        finish();
+        return;
+    }
+
+    const QJsonObject record = m_records.at(m_next++);
+    const QString type = record.value(QStringLiteral("type")).toString();
+
+    // printable keys are recorded as "x"
+    const bool typed = type == QLatin1String("key")
+        && (record.value(QStringLiteral("text")).toString() == QLatin1String("x")
+            || record.value(QStringLiteral("key")).toInt() == Qt::Key_Backspace);
+    const bool warm = typed && ++m_typedKeys > s_warmupKeys;
+
+    const quint64 dispatchBefore = AllocCounter::count(AllocCounter::Dispatch);
+    const quint64 postedBefore = AllocCounter::count(AllocCounter::Posted);
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool delivered = replay(record);
+    AllocCounter::setPhase(AllocCounter::Posted);
+    QCoreApplication::sendPostedEvents();
+    AllocCounter::setPhase(AllocCounter::Idle);
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const quint64 dispatchAllocs = AllocCounter::count(AllocCounter::Dispatch) - dispatchBefore;
+    const quint64 postedAllocs = AllocCounter::count(AllocCounter::Posted) - postedBefore;
+    m_lastType.clear();
+    m_lastTyped = warm;
+
+    if (delivered) {
+        Cost &cost = m_costs[type];
+        ++cost.count;
+        cost.totalNs += elapsed;
+        cost.maxNs = qMax(cost.maxNs, elapsed);
+        cost.dispatchAllocs += dispatchAllocs;
+        cost.postedAllocs += postedAllocs;
+        m_lastType = type;
+
+        if (warm) {
+            m_typingAllocs += dispatchAllocs + postedAllocs;
+        }
+
+        if (m_budgetNs > 0 && elapsed > m_budgetNs) {
+            ++m_overBudget;
+            qWarning().nospace() << "Record " << m_next - 1 << " took " << elapsed / 1000 << " us";
+        }
+    } else {
+        ++m_dropped;
+    }
+
+    // back to the event loop, so rendering and timers run like they would live
+    QTimer::singleShot(0, this, &ReplayHarness::replayNext);
+    m_frameAllocs = AllocCounter::count(AllocCounter::Frame);
+    AllocCounter::setPhase(AllocCounter::Frame);
+}
+
+bool ReplayHarness::replay(const QJsonObject &record)
+{
+    const QString type = record.value(QStringLiteral("type")).toString();
+
+    if (type == QLatin1String("screens")) {
+        QList<QRect> geometries;
+        for (const QJsonValue &screen : record.value(QStringLiteral("screens")).toArray()) {
+            geometries << rectFromJson(screen);
+        }
+        if (geometries.isEmpty()) {
+            return false;
+        }
+        AllocCounter::setPhase(AllocCounter::Dispatch);
+        m_app->setFakeScreens(geometries);
+        return true;
+    }
+
+    if (type == QLatin1String("geometry")) {
+        const int screen = record.value(QStringLiteral("screen")).toInt();
+        const QRect geometry = rectFromJson(record.value(QStringLiteral("geometry")));
+        AllocCounter::setPhase(AllocCounter::Dispatch);
+        m_app->setFakeScreenGeometry(screen, geometry);
+        return true;
+    }
+
+    const QList<QQuickView *> views = m_app->views();
+    const int viewIndex = record.value(QStringLiteral("view")).toInt(-1);
+    if (viewIndex < 0 || viewIndex >= views.count()) {
+        return false;
+    }
+    QQuickView *view = views.at(viewIndex);
+
+    if (type == QLatin1String("key")) {
+        QKeyEvent event(record.value(QStringLiteral("press")).toBool() ? QEvent::KeyPress : QEvent::KeyRelease,
+                        record.value(QStringLiteral("key")).toInt(),
+                        Qt::KeyboardModifiers(record.value(QStringLiteral("modifiers")).toInt()),
+                        record.value(QStringLiteral("text")).toString(),
+                        record.value(QStringLiteral("autoRepeat")).toBool());
+        AllocCounter::setPhase(AllocCounter::Dispatch);
+        QCoreApplication::sendEvent(view, &event);
+        return true;
+    }
+
+    if (type == QLatin1String("mouse")) {
+        const QPointF position(record.value(QStringLiteral("x")).toDouble(), record.value(QStringLiteral("y")).toDouble());
+        QMouseEvent event(QEvent::Type(record.value(QStringLiteral("event")).toInt()),
+                          position,
+                          view->mapToGlobal(position),
+                          Qt::MouseButton(record.value(QStringLiteral("button")).toInt()),
+                          Qt::MouseButtons(record.value(QStringLiteral("buttons")).toInt()),
+                          Qt::KeyboardModifiers(record.value(QStringLiteral("modifiers")).toInt()));
+        AllocCounter::setPhase(AllocCounter::Dispatch);
+        QCoreApplication::sendEvent(view, &event);
+        return true;
+    }
+
+    return false;
+}
+
+void ReplayHarness::finish()
+{
+    QJsonObject types;
+    for (auto it = m_costs.constBegin(); it != m_costs.constEnd(); ++it) {
+        QJsonObject cost;
+        cost.insert(QStringLiteral("count"), it->count);
+        cost.insert(QStringLiteral("meanUs"), it->count ? it->totalNs / it->count / 1000.0 : 0.0);
+        cost.insert(QStringLiteral("maxUs"), it->maxNs / 1000.0);
+        if (AllocCounter::isAvailable()) {
+            QJsonObject allocs;
+            allocs.insert(QStringLiteral("dispatch"), double(it->dispatchAllocs));
+            allocs.insert(QStringLiteral("posted"), double(it->postedAllocs));
+            allocs.insert(QStringLiteral("frame"), double(it->frameAllocs));
+            cost.insert(QStringLiteral("allocations"), allocs);
+        }
+        types.insert(it.key(), cost);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("records"), m_records.count());
+    root.insert(QStringLiteral("dropped"), m_dropped);
+    root.insert(QStringLiteral("budgetUs"), m_budgetNs > 0 ? m_budgetNs / 1000.0 : -1.0);
+    root.insert(QStringLiteral("overBudget"), m_overBudget);
+    root.insert(QStringLiteral("types"), types);
+
+    const bool tooManyAllocs = AllocCounter::isAvailable() && m_typingAllocs > m_typingAllocBudget;
+    if (AllocCounter::isAvailable()) {
+        // typing past the warm-up; the frame is reported but not held to the budget
+        QJsonObject typing;
+        typing.insert(QStringLiteral("keys"), qMax(0, m_typedKeys - s_warmupKeys));
+        typing.insert(QStringLiteral("allocations"), double(m_typingAllocs));
+        typing.insert(QStringLiteral("frameAllocations"), double(m_typingFrameAllocs));
+        typing.insert(QStringLiteral("budget"), double(m_typingAllocBudget));
+        root.insert(QStringLiteral("typing"), typing);
+    }
+
+    const QByteArray report = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    QFile file;
+    if (m_reportFile.isEmpty()) {
+        file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(m_reportFile);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    file.write(report);
+    file.close();
+
+    QCoreApplication::exit(m_overBudget > 0 || tooManyAllocs ? 1 : 0);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYHARNESS_H
+#define REPLAYHARNESS_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMap>
+#include <QRect>
+
+class Application;
+class QEvent;
+
+// Writes the input reaching the lock screen views and every change of the
+// screen topology to a JSON lines file (CUTEFISH_SCREENLOCKER_RECORD).
+// Printable keys are all recorded as "x", so a recording never contains
+// any part of a password.
+class EventRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EventRecorder(const QString &fileName, QObject *parent = nullptr);
+
+    void recordEvent(int viewIndex, QEvent *event);
+    void recordScreens(const QList<QRect> &geometries);
+    void recordGeometry(int screenIndex, const QRect &geometry);
+
+private:
+    void write(QJsonObject record);
+
+private:
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+// Plays a recording back as fast as possible against fake screens on the
+// offscreen platform (--replay <file>). Each record is delivered through
+// the normal event path and timed until all events it posted have been
+// processed. A JSON report with the cost per record type is written at
+// the end, the process exits non-zero if a record took longer than
+// CUTEFISH_SCREENLOCKER_REPLAY_BUDGET_US.
+//
+// In builds with ENABLE_ALLOC_COUNT the heap allocations of every record are
+// counted per phase (see AllocCounter). Once warmed up, typing a character
+// or Backspace must not allocate while the key is dispatched and its posted
+// events run; the process exits non-zero when the keys allocated more than
+// CUTEFISH_SCREENLOCKER_REPLAY_KEY_ALLOCS (default 0) times in total.
+class ReplayHarness : public QObject
+{
+    Q_OBJECT
+
+public:
+    ReplayHarness(Application *app, const QString &fileName, const QString &reportFile, QObject *parent = nullptr);
+
+    // Screens of the first topology record, to set up the views with
+    bool load();
+    QList<QRect> initialScreens() const;
+
+    void start();
+
+private:
+    void replayNext();
+    bool replay(const QJsonObject &record);
+    void finish();
+
+private:
+    struct Cost {
+        int count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        quint64 dispatchAllocs = 0;
+        quint64 postedAllocs = 0;
+        quint64 frameAllocs = 0;
+    };
+
+    Application *m_app;
+    QString m_fileName;
+    QString m_reportFile;
+    QList<QJsonObject> m_records;
+    int m_next = 0;
+    int m_dropped = 0;
+    qint64 m_budgetNs = -1;
+    int m_overBudget = 0;
+    QMap<QString, Cost> m_costs;
+
+    // Allocation counting, see AllocCounter
+    QString m_lastType;
+    bool m_lastTyped = false;
+    quint64 m_frameAllocs = 0;
+    int m_typedKeys = 0;
+    quint64 m_typingAllocs = 0;
+    quint64 m_typingFrameAllocs = 0;
+    quint64 m_typingAllocBudget = 0;
+};
+
+#endif // REPLAYHARNESS_H
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "securebuffer.h"
+
+#include <config-screenlocker.h>
+
+#include <QDebug>
+
+// system
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+void secureZero(void *data, size_t size)
+{
+#if HAVE_EXPLICIT_BZERO
+    explicit_bzero(data, size);
+#else
+    volatile char *p = static_cast<volatile char *>(data);
+    while (size--) {
+        *p++ = 0;
+    }
+#endif
+}
+
+SecureBuffer::SecureBuffer()
+{
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
+
+    void *page = ::mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page != MAP_FAILED) {
+        m_mapped = true;
+        m_locked = ::mlock(page, pageSize) == 0;
+        if (!m_locked) {
+            qWarning() << "Could not lock the password buffer in memory:" << strerror(errno);
+        }
+#if HAVE_MADV_DONTDUMP
+        ::madvise(page, pageSize, MADV_DONTDUMP);
+#endif
+    } else {
+        // still never reallocated and wiped, only not locked
+        page = ::calloc(1, pageSize);
+        Q_CHECK_PTR(page);
+    }
+
+    m_data = static_cast<char *>(page);
+    m_capacity = pageSize - 1;
+}
+
+SecureBuffer::~SecureBuffer()
+{
+    secureZero(m_data, m_capacity + 1);
+
+    if (m_mapped) {
+        if (m_locked) {
+            ::munlock(m_data, m_capacity + 1);
+        }
+        ::munmap(m_data, m_capacity + 1);
+    } else {
+        ::free(m_data);
+    }
+}
+
+bool SecureBuffer::append(QStringView text)
+{
+    // encoded in place, QString::toUtf8() would leave a copy on the heap
+    for (auto it = text.begin(); it != text.end(); ++it) {
+        char32_t ucs = it->unicode();
+        if (QChar::isHighSurrogate(ucs) && it + 1 != text.end() && (it + 1)->isLowSurrogate()) {
+            ucs = QChar::surrogateToUcs4(ucs, (++it)->unicode());
+        } else if (QChar::isSurrogate(ucs)) {
+            ucs = QChar::ReplacementCharacter;
+        }
+
+        char bytes[4];
+        int count;
+        if (ucs < 0x80) {
+            bytes[0] = char(ucs);
+            count = 1;
+        } else if (ucs < 0x800) {
+            bytes[0] = char(0xc0 | (ucs >> 6));
+            bytes[1] = char(0x80 | (ucs & 0x3f));
+            count = 2;
+        } else if (ucs < 0x10000) {
+            bytes[0] = char(0xe0 | (ucs >> 12));
+            bytes[1] = char(0x80 | ((ucs >> 6) & 0x3f));
+            bytes[2] = char(0x80 | (ucs & 0x3f));
+            count = 3;
+        } else {
+            bytes[0] = char(0xf0 | (ucs >> 18));
+            bytes[1] = char(0x80 | ((ucs >> 12) & 0x3f));
+            bytes[2] = char(0x80 | ((ucs >> 6) & 0x3f));
+            bytes[3] = char(0x80 | (ucs & 0x3f));
+            count = 4;
+        }
+
+        const bool fits = m_size + count <= m_capacity;
+        if (fits) {
+            memcpy(m_data + m_size, bytes, count);
+            m_size += count;
+            ++m_length;
+        }
+        secureZero(bytes, sizeof(bytes));
+        if (!fits) {
+            return false;
+        }
+    }
+
+    m_data[m_size] = 0;
+    return true;
+}
+
+bool SecureBuffer::appendUtf8(const char *data, int size)
+{
+    // whole characters only
+    int end = qMin(size, m_capacity - m_size);
+    if (end < size) {
+        while (end > 0 && (data[end] & 0xc0) == 0x80) {
+            --end;
+        }
+    }
+
+    for (int i = 0; i < end; ++i) {
+        if ((data[i] & 0xc0) != 0x80) {
+            ++m_length;
+        }
+    }
+    memcpy(m_data + m_size, data, end);
+    m_size += end;
+    m_data[m_size] = 0;
+
+    return end == size;
+}
+
+bool SecureBuffer::append(const SecureBuffer &other)
+{
+    return appendUtf8(other.m_data, other.m_size);
+}
+
+int SecureBuffer::readFrom(int fd, int maxSize)
+{
+    const int room = m_capacity - m_size;
+    if (room <= 0) {
+        char discard[256];
+        const int ret = ::read(fd, discard, qMin<int>(maxSize, sizeof(discard)));
+        secureZero(discard, sizeof(discard));
+        return ret;
+    }
+
+    const int ret = ::read(fd, m_data + m_size, qMin(maxSize, room));
+    for (int i = 0; i < ret; ++i) {
+        if ((m_data[m_size + i] & 0xc0) != 0x80) {
+            ++m_length;
+        }
+    }
+    if (ret > 0) {
+        m_size += ret;
+    }
+    m_data[m_size] = 0;
+    return ret;
+}
+
+void SecureBuffer::chop(int characters)
+{
+    while (characters-- > 0 && m_size > 0) {
+        // back to the lead byte of the last character
+        int start = m_size - 1;
+        while (start > 0 && (m_data[start] & 0xc0) == 0x80) {
+            --start;
+        }
+        secureZero(m_data + start, m_size - start);
+        m_size = start;
+        --m_length;
+    }
+}
+
+void SecureBuffer::assign(const SecureBuffer &other)
+{
+    clear();
+    append(other);
+}
+
+void SecureBuffer::clear()
+{
+    secureZero(m_data, m_size);
+    m_size = 0;
+    m_length = 0;
+}
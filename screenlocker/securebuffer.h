@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SECUREBUFFER_H
+#define SECUREBUFFER_H
+
+#include <QStringView>
+
+// UTF-8 storage for a password: one anonymous page, locked in memory so it
+// is never swapped, left out of core dumps and wiped when cleared. It has a
+// fixed capacity and is never reallocated, so typing leaves no stale copies
+// behind in freed memory. The data is always NUL terminated and goes to the
+// helper socket as it is.
+class SecureBuffer
+{
+public:
+    SecureBuffer();
+    ~SecureBuffer();
+
+    // Appends as much as fits, returns false if something was cut off
+    bool append(QStringView text);
+    bool appendUtf8(const char *data, int size);
+    bool append(const SecureBuffer &other);
+
+    // Reads up to maxSize bytes from fd straight into the page, returns
+    // what read() returned. Bytes beyond the capacity are read and wiped.
+    int readFrom(int fd, int maxSize);
+
+    // Removes the last characters, not bytes
+    void chop(int characters);
+
+    void assign(const SecureBuffer &other);
+    void clear();
+
+    const char *constData() const { return m_data; }
+    int size() const { return m_size; }
+    int length() const { return m_length; }
+    bool isEmpty() const { return m_size == 0; }
+
+    // Whether the page could be locked, RLIMIT_MEMLOCK may be 0
+    bool isLocked() const { return m_locked; }
+
+private:
+    Q_DISABLE_COPY(SecureBuffer)
+
+    char *m_data = nullptr;
+    int m_capacity = 0;
+    int m_size = 0;
+    int m_length = 0;
+    bool m_mapped = false;
+    bool m_locked = false;
+};
+
+// Overwrites memory in a way the compiler may not drop
+void secureZero(void *data, size_t size);
+
+#endif // SECUREBUFFER_H
@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "soakrunner.h"
+#include "application.h"
+#include "dbusaudit.h"
+#include "earlyinput.h"
+#include "greeterlink.h"
+#include "kcheckpass-enums.h"
+#include "securebuffer.h"
+
+#include <QCoreApplication>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QQuickItem>
+#include <QQuickView>
+#include <QTimer>
+
+// system
+#include <fcntl.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const QString s_playerPath = QStringLiteral("/org/mpris/MediaPlayer2");
+static const QString s_playerInterface = QStringLiteral("org.mpris.MediaPlayer2.Player");
+
+// One tick is one minute of locked time
+static const int s_ticksPerHour = 60;
+
+// The second screen is plugged for half of every cycle, samples are taken
+// at the start of a cycle when the topology matches the initial one
+static const int s_screenCycle = 120;
+static const int s_trackInterval = 4;
+static const int s_unlockInterval = 10;
+
+static qint64 residentKb()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.value(1).toLongLong() * ::sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static qint64 heapKb()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return qint64(mallinfo2().uordblks) / 1024;
+#else
+    return -1;
+#endif
+}
+
+// Typed at every attempt and looked for in memory at the end
+static const char s_secret[] = "soak-Secret-7f3a";
+
+// Copies of the secret, in UTF-8 or UTF-16, in the heap and the anonymous
+// mappings. The needles live on the stack, which is not searched, and the
+// password buffers are wiped by then, so any hit is a copy left behind.
+static int secretCopies()
+{
+    char utf8[sizeof(s_secret) - 1];
+    char16_t utf16[sizeof(s_secret) - 1];
+    for (size_t i = 0; i < sizeof(utf8); ++i) {
+        utf8[i] = s_secret[i];
+        utf16[i] = s_secret[i];
+    }
+
+    QFile maps(QStringLiteral("/proc/self/maps"));
+    if (!maps.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    int copies = 0;
+    const auto count = [&copies](const char *begin, const char *end, const void *needle, size_t size) {
+        for (const char *p = begin; p + size <= end; ++p) {
+            p = static_cast<const char *>(memchr(p, *static_cast<const char *>(needle), end - p));
+            if (!p || p + size > end) {
+                break;
+            }
+            if (memcmp(p, needle, size) == 0) {
+                ++copies;
+            }
+        }
+    };
+
+    const QList<QByteArray> lines = maps.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        // address perms offset dev inode [path]
+        const QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.count() < 5 || !fields.at(1).startsWith("rw")) {
+            continue;
+        }
+        const QByteArray path = fields.value(5);
+        if (!path.isEmpty() && path != "[heap]") {
+            continue;
+        }
+
+        const QList<QByteArray> range = fields.at(0).split('-');
+        const auto *begin = reinterpret_cast<const char *>(range.at(0).toULongLong(nullptr, 16));
+        const auto *end = reinterpret_cast<const char *>(range.at(1).toULongLong(nullptr, 16));
+        count(begin, end, utf8, sizeof(utf8));
+        count(begin, end, utf16, sizeof(utf16));
+    }
+
+    secureZero(utf8, sizeof(utf8));
+    secureZero(utf16, sizeof(utf16));
+    return copies;
+}
+
+static int openFds()
+{
+    return QDir(QStringLiteral("/proc/self/fd")).entryList(QDir::Files | QDir::System | QDir::NoDotAndDotDot).count();
+}
+
+SoakPlayer::SoakPlayer(QObject *parent)
+    : QObject(parent)
+    , m_connection(QStringLiteral("cutefish-screenlocker-soak"))
+{
+    new SoakPlayerRootAdaptor(this);
+    new SoakPlayerAdaptor(this);
+}
+
+SoakPlayer::~SoakPlayer()
+{
+    QDBusConnection::disconnectFromBus(m_connection.name());
+}
+
+bool SoakPlayer::registerPlayer()
+{
+    // a connection of its own, MprisManager must see a separate peer
+    m_connection = QDBusConnection::connectToBus(QDBusConnection::SessionBus, QStringLiteral("cutefish-screenlocker-soak"));
+    if (!m_connection.isConnected()) {
+        return false;
+    }
+
+    nextTrack();
+
+    return m_connection.registerObject(s_playerPath, this, QDBusConnection::ExportAdaptors)
+           && DBusAudit::registerService(m_connection,
+                                         QStringLiteral("org.mpris.MediaPlayer2.cutefishsoak%1").arg(QCoreApplication::applicationPid()),
+                                         "SoakPlayer::registerPlayer");
+}
+
+void SoakPlayer::nextTrack()
+{
+    ++m_track;
+
+    m_metadata.clear();
+    m_metadata.insert(QStringLiteral("mpris:trackid"), QVariant::fromValue(QDBusObjectPath(QStringLiteral("/soak/track%1").arg(m_track))));
+    m_metadata.insert(QStringLiteral("xesam:title"), QStringLiteral("Track %1").arg(m_track));
+    m_metadata.insert(QStringLiteral("xesam:artist"), QStringList { QStringLiteral("Artist %1").arg(m_track % 7) });
+
+    if (!m_connection.isConnected()) {
+        return;
+    }
+
+    QDBusMessage signal = QDBusMessage::createSignal(s_playerPath,
+                                                     QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                     QStringLiteral("PropertiesChanged"));
+    signal << s_playerInterface << QVariantMap { { QStringLiteral("Metadata"), m_metadata } } << QStringList();
+    m_connection.send(signal);
+}
+
+SoakPlayerRootAdaptor::SoakPlayerRootAdaptor(SoakPlayer *player)
+    : QDBusAbstractAdaptor(player)
+{
+}
+
+SoakPlayerAdaptor::SoakPlayerAdaptor(SoakPlayer *player)
+    : QDBusAbstractAdaptor(player)
+    , m_player(player)
+{
+}
+
+SoakRunner::SoakRunner(Application *app, double hours, const QString &reportFile, QObject *parent)
+    : QObject(parent)
+    , m_app(app)
+    , m_reportFile(reportFile)
+    , m_totalTicks(qMax(1, qRound(hours * s_ticksPerHour)))
+    , m_timer(new QTimer(this))
+{
+    bool ok = false;
+    const int tickMs = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_SOAK_TICK_MS", &ok);
+
+    m_timer->setObjectName(QStringLiteral("soakTimer"));
+    m_timer->setInterval(ok && tickMs > 0 ? tickMs : 50);
+    connect(m_timer, &QTimer::timeout, this, &SoakRunner::tick);
+
+    connect(m_app->authenticator(), &Authenticator::failed, this, [this] { ++m_failures; });
+
+    // every unlock attempt goes to the stand-in helper, never to PAM
+    qputenv("CUTEFISH_SCREENLOCKER_FAKE_CHECKPASS", "1");
+    KCheckPass::setHelper(QCoreApplication::applicationFilePath());
+}
+
+SoakRunner::~SoakRunner()
+{
+    if (m_holder.state() != QProcess::NotRunning) {
+        m_holder.kill();
+        m_holder.waitForFinished(1000);
+    }
+
+    m_playerThread.quit();
+    m_playerThread.wait();
+}
+
+void SoakRunner::start()
+{
+    m_player = new SoakPlayer;
+    m_player->moveToThread(&m_playerThread);
+    connect(&m_playerThread, &QThread::finished, m_player, &QObject::deleteLater);
+    m_playerThread.start();
+
+    bool registered = false;
+    QMetaObject::invokeMethod(m_player, "registerPlayer", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, registered));
+    if (!registered) {
+        qWarning() << "No session bus for the stand-in MPRIS player, track changes are skipped";
+    }
+
+    startHolder();
+    m_timer->start();
+}
+
+void SoakRunner::tick()
+{
+    if (m_tick >= m_totalTicks) {
+        m_timer->stop();
+        finish();
+        return;
+    }
+
+    tickClocks();
+
+    if (m_tick % s_screenCycle == 0) {
+        sample();
+    }
+    if (m_tick % (s_screenCycle / 2) == s_screenCycle / 4) {
+        plugScreens();
+    }
+    if (m_tick % s_trackInterval == 0) {
+        QMetaObject::invokeMethod(m_player, "nextTrack", Qt::QueuedConnection);
+    }
+    if (m_tick % s_unlockInterval == 0) {
+        failUnlock();
+    } else if (m_tick % s_unlockInterval == s_unlockInterval / 2) {
+        handOff();
+    }
+
+    ++m_tick;
+}
+
+void SoakRunner::tickClocks()
+{
+    for (QQuickView *view : m_app->views()) {
+        if (!view->rootObject()) {
+            continue;
+        }
+
+        const QList<QObject *> timers = view->rootObject()->findChildren<QObject *>(QStringLiteral("clockTimer"));
+        for (QObject *timer : timers) {
+            QMetaObject::invokeMethod(timer, "triggered");
+        }
+    }
+}
+
+void SoakRunner::plugScreens()
+{
+    m_extraScreen = !m_extraScreen;
+
+    QList<QRect> screens { QRect(0, 0, 1920, 1080) };
+    if (m_extraScreen) {
+        screens << QRect(1920, 0, 1280, 1024);
+    }
+    m_app->setFakeScreens(screens);
+}
+
+void SoakRunner::startHolder()
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        return;
+    }
+
+    // fds[1] is inherited by the stand-in, as with GreeterProcess
+    const int childFd = fds[1];
+    m_holder.setProcessChannelMode(QProcess::ForwardedChannels);
+    m_holder.setChildProcessModifier([childFd] {
+        ::fcntl(childFd, F_SETFD, 0);
+    });
+    m_holder.start(QCoreApplication::applicationFilePath(), { QStringLiteral("--soak-holder"), QString::number(childFd) });
+    ::close(childFd);
+
+    if (!m_holder.waitForStarted()) {
+        qWarning() << "Could not start the stand-in lock holder" << m_holder.errorString();
+        ::close(fds[0]);
+        return;
+    }
+
+    m_holderFd = fds[0];
+    m_app->setHolderLink(m_holderFd, false);
+}
+
+void SoakRunner::handOff()
+{
+    if (!m_app->holderLink() || !m_app->holderLink()->isConnected() || m_app->authenticator()->isGraceLocked()) {
+        return;
+    }
+
+    // the stand-in types the secret on its covers and hands it over
+    ++m_attempts;
+    m_app->holderLink()->send("soak-handoff");
+}
+
+void SoakRunner::failUnlock()
+{
+    if (m_app->authenticator()->isGraceLocked()) {
+        return;
+    }
+
+    QQuickView *view = m_app->views().value(0);
+    if (!view) {
+        return;
+    }
+
+    // through the same key path as a user, down to the helper
+    ++m_attempts;
+    for (const char *c = s_secret; *c; ++c) {
+        const QString text = QString(QLatin1Char(*c));
+        QKeyEvent press(QEvent::KeyPress, Qt::Key_unknown, Qt::NoModifier, text);
+        QCoreApplication::sendEvent(view, &press);
+        QKeyEvent release(QEvent::KeyRelease, Qt::Key_unknown, Qt::NoModifier, text);
+        QCoreApplication::sendEvent(view, &release);
+    }
+    QKeyEvent press(QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier, QStringLiteral("\r"));
+    QCoreApplication::sendEvent(view, &press);
+    QKeyEvent release(QEvent::KeyRelease, Qt::Key_Return, Qt::NoModifier, QStringLiteral("\r"));
+    QCoreApplication::sendEvent(view, &release);
+}
+
+void SoakRunner::sample()
+{
+    int objects = 0;
+    for (QQuickView *view : m_app->views()) {
+        if (view->rootObject()) {
+            objects += view->rootObject()->findChildren<QObject *>().count();
+        }
+    }
+
+    QJsonObject sample;
+    sample.insert(QStringLiteral("hour"), double(m_tick) / s_ticksPerHour);
+    sample.insert(QStringLiteral("rssKb"), residentKb());
+    sample.insert(QStringLiteral("heapKb"), heapKb());
+    sample.insert(QStringLiteral("fds"), openFds());
+    sample.insert(QStringLiteral("objects"), objects);
+    m_samples.append(sample);
+}
+
+void SoakRunner::finish()
+{
+    sample();
+
+    m_app->authenticator()->password()->clear();
+    const int copies = secretCopies();
+
+    // the stand-in holder counts its own copies once the link goes down
+    int holderCopies = -1;
+    if (m_holderFd >= 0) {
+        ::shutdown(m_holderFd, SHUT_RDWR);
+        if (m_holder.waitForFinished(10000) && m_holder.exitStatus() == QProcess::NormalExit && m_holder.exitCode() <= 100) {
+            holderCopies = m_holder.exitCode();
+        }
+    }
+
+    bool ok = false;
+    int maxRssGrowthKb = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_SOAK_MAX_RSS_KB", &ok);
+    if (!ok) {
+        maxRssGrowthKb = 4096;
+    }
+
+    // the first cycle warms up caches, compare against the second sample
+    const QJsonObject first = m_samples.at(qMin(1, m_samples.count() - 1)).toObject();
+    const QJsonObject last = m_samples.last().toObject();
+
+    QStringList failures;
+    const qint64 rssGrowth = last.value(QStringLiteral("rssKb")).toInteger() - first.value(QStringLiteral("rssKb")).toInteger();
+    if (rssGrowth > maxRssGrowthKb) {
+        failures << QStringLiteral("rss grew by %1 kB").arg(rssGrowth);
+    }
+    if (last.value(QStringLiteral("fds")).toInt() > first.value(QStringLiteral("fds")).toInt()) {
+        failures << QStringLiteral("file descriptors leaked");
+    }
+    if (last.value(QStringLiteral("objects")).toInt() > first.value(QStringLiteral("objects")).toInt()) {
+        failures << QStringLiteral("QML objects leaked");
+    }
+    if (copies != 0) {
+        failures << QStringLiteral("%1 copies of the password left in memory").arg(copies);
+    }
+    if (holderCopies < 0) {
+        failures << QStringLiteral("the stand-in lock holder did not report");
+    } else if (holderCopies != 0) {
+        failures << QStringLiteral("%1 copies of the password left in the lock holder").arg(holderCopies);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("hours"), double(m_totalTicks) / s_ticksPerHour);
+    root.insert(QStringLiteral("unlockAttempts"), m_attempts);
+    root.insert(QStringLiteral("unlockFailures"), m_failures);
+    root.insert(QStringLiteral("passwordCopies"), copies);
+    root.insert(QStringLiteral("holderPasswordCopies"), holderCopies);
+    root.insert(QStringLiteral("maxRssGrowthKb"), maxRssGrowthKb);
+    root.insert(QStringLiteral("samples"), m_samples);
+    root.insert(QStringLiteral("failures"), QJsonArray::fromStringList(failures));
+
+    const QByteArray report = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    QFile file;
+    if (m_reportFile.isEmpty()) {
+        file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(m_reportFile);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    file.write(report);
+    file.close();
+
+    QCoreApplication::exit(failures.isEmpty() ? 0 : 1);
+}
+
+static bool readFully(int fd, void *buf, int count)
+{
+    for (int done = 0; done < count;) {
+        const ssize_t ret = ::read(fd, static_cast<char *>(buf) + done, count - done);
+        if (ret <= 0) {
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+int SoakRunner::runFakeCheckPass(int fd)
+{
+    // the greeter sets the password before starting us, no need to wait for SIGUSR1
+    ::signal(SIGUSR1, SIG_IGN);
+
+    int request = ConvPutReadyForAuthentication;
+    if (::write(fd, &request, sizeof(request)) != sizeof(request)) {
+        return 1;
+    }
+
+    int prompt[2] = { ConvGetHidden, 0 };
+    if (::write(fd, prompt, sizeof(prompt)) != sizeof(prompt)) {
+        return 1;
+    }
+
+    int length = 0;
+    if (!readFully(fd, &length, sizeof(length))) {
+        return 1;
+    }
+    if (length > 0) {
+        QByteArray discard(length + int(sizeof(int)), Qt::Uninitialized);
+        if (!readFully(fd, discard.data(), discard.size())) {
+            return 1;
+        }
+    }
+
+    request = ConvPutAuthFailed;
+    if (::write(fd, &request, sizeof(request)) != sizeof(request)) {
+        return 1;
+    }
+
+    // until the greeter reaps us
+    char byte;
+    while (::read(fd, &byte, 1) > 0) {
+    }
+    return 0;
+}
+
+int SoakRunner::runHolderStandIn(int &argc, char **argv, int fd)
+{
+    QCoreApplication app(argc, argv);
+
+    GreeterLink link(fd);
+    EarlyInput input;
+
+    QObject::connect(&link, &GreeterLink::messageReceived, &app, [&link, &input](const QByteArray &message) {
+        if (message == "ready") {
+            link.send("grab");
+        } else if (message == "soak-handoff") {
+            // the same path as keys on LockHolder's covers
+            for (const char *c = s_secret; *c; ++c) {
+                QKeyEvent press(QEvent::KeyPress, Qt::Key_unknown, Qt::NoModifier, QString(QLatin1Char(*c)));
+                input.addKey(&press);
+            }
+            link.sendInput(input.text());
+            link.send("submit");
+            input.clear();
+        }
+    });
+    QObject::connect(&link, &GreeterLink::disconnected, &app, [] {
+        const int copies = secretCopies();
+        QCoreApplication::exit(copies < 0 ? 255 : qMin(copies, 100));
+    });
+
+    return app.exec();
+}
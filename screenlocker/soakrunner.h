@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOAKRUNNER_H
+#define SOAKRUNNER_H
+
+#include <QObject>
+#include <QDBusAbstractAdaptor>
+#include <QDBusConnection>
+#include <QJsonArray>
+#include <QProcess>
+#include <QThread>
+#include <QVariantMap>
+
+class Application;
+class QTimer;
+
+// Stand-in MPRIS player for the soak run, lives on its own thread and
+// connection so blocking calls of the greeter into it can not deadlock.
+class SoakPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SoakPlayer(QObject *parent = nullptr);
+    ~SoakPlayer() override;
+
+    QVariantMap metadata() const { return m_metadata; }
+
+public slots:
+    bool registerPlayer();
+    void nextTrack();
+
+private:
+    QDBusConnection m_connection;
+    QVariantMap m_metadata;
+    int m_track = 0;
+};
+
+class SoakPlayerRootAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.mpris.MediaPlayer2")
+    Q_PROPERTY(QString Identity READ identity)
+
+public:
+    explicit SoakPlayerRootAdaptor(SoakPlayer *player);
+
+    QString identity() const { return QStringLiteral("Screen locker soak"); }
+};
+
+class SoakPlayerAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.mpris.MediaPlayer2.Player")
+    Q_PROPERTY(QVariantMap Metadata READ metadata)
+    Q_PROPERTY(QString PlaybackStatus READ playbackStatus)
+
+public:
+    explicit SoakPlayerAdaptor(SoakPlayer *player);
+
+    QVariantMap metadata() const { return m_player->metadata(); }
+    QString playbackStatus() const { return QStringLiteral("Playing"); }
+
+private:
+    SoakPlayer *m_player;
+};
+
+// Runs the greeter for hours of accelerated time (--soak <hours>) on the
+// offscreen platform: every tick is one minute for the clock, tracks
+// change, screens come and go and unlock attempts fail against a stand-in
+// helper. A stand-in lock holder in a child process hands typed text over
+// the holder link, as the real one does after a greeter respawn. Memory, file descriptors and object counts are sampled whenever
+// the screen topology is back to its initial state, and the run fails if
+// they grew past the thresholds between the first and the last sample.
+class SoakRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    SoakRunner(Application *app, double hours, const QString &reportFile, QObject *parent = nullptr);
+    ~SoakRunner() override;
+
+    void start();
+
+    // Stand-in for ccheckpass, rejects every password
+    static int runFakeCheckPass(int fd);
+
+    // Stand-in lock holder on the greeter link (--soak-holder <fd>), its
+    // exit code is the number of password copies left in its memory
+    static int runHolderStandIn(int &argc, char **argv, int fd);
+
+private:
+    void tick();
+    void tickClocks();
+    void plugScreens();
+    void startHolder();
+    void failUnlock();
+    void handOff();
+    void sample();
+    void finish();
+
+private:
+    Application *m_app;
+    QString m_reportFile;
+    int m_totalTicks;
+    int m_tick = 0;
+    int m_attempts = 0;
+    int m_failures = 0;
+    bool m_extraScreen = false;
+
+    QTimer *m_timer;
+    QThread m_playerThread;
+    SoakPlayer *m_player = nullptr;
+
+    QProcess m_holder;
+    int m_holderFd = -1;
+
+    QJsonArray m_samples;
+};
+
+#endif // SOAKRUNNER_H
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stallwatchdog.h"
+
+#include <config-screenlocker.h>
+
+#include <QAbstractEventDispatcher>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+// system
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// SIGURG is ignored by default, so a stray one can never take the lock down
+static const int s_stackSignal = SIGURG;
+static const int s_maxFrames = 64;
+
+static std::atomic<const char *> s_operation { nullptr };
+
+static void *s_frames[s_maxFrames];
+static std::atomic<int> s_frameCount { -1 };
+
+static void captureStack(int)
+{
+    const int savedErrno = errno;
+    s_frameCount = backtrace(s_frames, s_maxFrames);
+    errno = savedErrno;
+}
+
+StallWatchdog::Operation::Operation(const char *name)
+    : m_previous(s_operation.exchange(name))
+{
+}
+
+StallWatchdog::Operation::~Operation()
+{
+    s_operation = m_previous;
+}
+
+StallWatchdog::StallWatchdog(QObject *parent)
+    : QThread(parent)
+    , m_thresholdMs(ENABLE_STALL_WATCHDOG ? qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_STALL_MS") : 0)
+    , m_guiThread(pthread_self())
+{
+    m_reportDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                  + QStringLiteral("/cutefish-screenlocker/stalls");
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    wait();
+}
+
+void StallWatchdog::attach()
+{
+    if (m_thresholdMs <= 0) {
+        return;
+    }
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    if (!dispatcher) {
+        return;
+    }
+
+    m_guiThread = pthread_self();
+
+    // backtrace() loads libgcc lazily, do it now rather than in the signal handler
+    void *frame;
+    backtrace(&frame, 1);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = captureStack;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(s_stackSignal, &action, nullptr);
+
+    connect(dispatcher, &QAbstractEventDispatcher::awake, this, &StallWatchdog::onAwake, Qt::DirectConnection);
+    connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, &StallWatchdog::onAboutToBlock, Qt::DirectConnection);
+
+    start(QThread::LowPriority);
+}
+
+void StallWatchdog::onAwake()
+{
+    m_busySince = now();
+    ++m_generation;
+
+    if (m_idleWaiting) {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_condition.notify_one();
+    }
+}
+
+void StallWatchdog::onAboutToBlock()
+{
+    m_busySince = 0;
+}
+
+void StallWatchdog::run()
+{
+    quint64 reportedGeneration = quint64(-1);
+    qint64 reportedSince = 0;
+
+    std::unique_lock<std::mutex> locker(m_mutex);
+    while (!m_stop) {
+        const qint64 busySince = m_busySince;
+        const quint64 generation = m_generation;
+
+        if (reportedSince && generation != reportedGeneration) {
+            qWarning() << "GUI thread recovered from stall after about" << now() - reportedSince << "ms";
+            reportedSince = 0;
+        }
+
+        // Sleep without any timeout while the event loop is idle
+        if (!busySince) {
+            m_idleWaiting = true;
+            m_condition.wait(locker, [this] {
+                return m_stop || m_busySince != 0;
+            });
+            m_idleWaiting = false;
+            continue;
+        }
+
+        const qint64 remaining = busySince + m_thresholdMs - now();
+        if (remaining > 0 || generation == reportedGeneration) {
+            m_condition.wait_for(locker, std::chrono::milliseconds(remaining > 0 ? remaining : m_thresholdMs));
+            continue;
+        }
+
+        if (m_busySince != busySince || m_generation != generation) {
+            continue;
+        }
+
+        locker.unlock();
+        writeReport(now() - busySince, s_operation.load());
+        locker.lock();
+
+        reportedGeneration = generation;
+        reportedSince = busySince;
+    }
+}
+
+void StallWatchdog::writeReport(qint64 stalledMs, const char *operation)
+{
+    s_frameCount = -1;
+    pthread_kill(m_guiThread, s_stackSignal);
+
+    // Give the GUI thread a moment to run the handler, it may be stuck in
+    // uninterruptible sleep in which case the report goes out without a stack
+    for (int i = 0; i < 20 && s_frameCount < 0; ++i) {
+        usleep(5000);
+    }
+
+    qWarning() << "GUI thread stalled for" << stalledMs << "ms in" << (operation ? operation : "unknown operation");
+
+    if (!QDir().mkpath(m_reportDir)) {
+        return;
+    }
+
+    const QString fileName = QStringLiteral("%1/stall-%2-%3.txt")
+                                 .arg(m_reportDir)
+                                 .arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-hhmmss")))
+                                 .arg(getpid());
+    const int fd = ::open(QFile::encodeName(fileName).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return;
+    }
+
+    const QByteArray header = QStringLiteral("stalled: %1 ms\noperation: %2\nstack:\n")
+                                  .arg(stalledMs)
+                                  .arg(QString::fromLatin1(operation ? operation : "unknown"))
+                                  .toUtf8();
+    if (::write(fd, header.constData(), header.size()) == header.size()) {
+        const int frames = s_frameCount;
+        if (frames > 0) {
+            backtrace_symbols_fd(s_frames, frames, fd);
+        } else {
+            static const char unavailable[] = "unavailable\n";
+            (void)::write(fd, unavailable, sizeof(unavailable) - 1);
+        }
+    }
+    ::close(fd);
+}
+
+qint64 StallWatchdog::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QThread>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include <pthread.h>
+
+// Watches the GUI thread's event loop from a thread of its own. When a
+// single event loop iteration runs for longer than the threshold, the
+// stack of the GUI thread and the operation marked in flight are written
+// to a report file. The watchdog only ever observes, it never touches the
+// lock itself.
+//
+// Built in unless configured with ENABLE_STALL_WATCHDOG=OFF, and off
+// unless CUTEFISH_SCREENLOCKER_STALL_MS sets a threshold. Until then no
+// thread is started and no signal handler installed. Reports go to
+// $XDG_CACHE_HOME/cutefish-screenlocker/stalls/.
+class StallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public:
+    // Marks what the GUI thread is doing, shows up in stall reports
+    class Operation
+    {
+    public:
+        explicit Operation(const char *name);
+        ~Operation();
+
+    private:
+        const char *m_previous;
+    };
+
+    explicit StallWatchdog(QObject *parent = nullptr);
+    ~StallWatchdog() override;
+
+    // Must be called from the GUI thread
+    void attach();
+
+protected:
+    void run() override;
+
+private:
+    void onAwake();
+    void onAboutToBlock();
+    void writeReport(qint64 stalledMs, const char *operation);
+
+    static qint64 now();
+
+private:
+    int m_thresholdMs;
+    QString m_reportDir;
+    pthread_t m_guiThread;
+
+    std::atomic<qint64> m_busySince { 0 };
+    std::atomic<quint64> m_generation { 0 };
+    std::atomic<bool> m_idleWaiting { false };
+    std::atomic<bool> m_stop { false };
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+#endif // STALLWATCHDOG_H
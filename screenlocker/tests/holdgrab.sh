@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Starts the locker while another client holds a keyboard and pointer grab
+# for <hold ms> and fails unless the locker secures input within 500 ms of
+# the grab going away. Runs inside a private X server and session bus:
+# xvfb-run -a dbus-run-session -- holdgrab.sh <locker> <hold ms>
+
+locker=$1
+hold=$2
+trap 'kill $grabber $lock 2>/dev/null' EXIT
+
+"$locker" --hold-grab "$hold" &
+grabber=$!
+sleep 0.2
+
+started=$(date +%s%N)
+"$locker" &
+lock=$!
+
+if ! wait $grabber; then
+    echo "competing grab failed"
+    exit 1
+fi
+released=$(( ($(date +%s%N) - started) / 1000000 ))
+
+# give the retry its backoff, then ask when the locker got the grab
+sleep 1
+secured=$(gdbus call -e -d com.cutefish.ScreenLocker -o /ScreenLocker -m com.cutefish.ScreenLocker.inputSecuredTime | tr -d '(),')
+echo "grab released after $released ms, input secured after $secured ms"
+
+# not before the other client let go, and right after it did
+awk -v secured="$secured" -v released="$released" \
+    'BEGIN { exit !(secured > 0 && secured >= released - 100 && secured <= released + 500) }'
@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Fails when lockActiveChanged(true) reaches a client later than the budget
+# after every view has presented. Runs inside a private X server and session
+# bus: xvfb-run -a dbus-run-session -- lockactive.sh <locker> <budget ms>
+
+locker=$1
+budget=$2
+log=$(mktemp)
+trap 'kill $watcher $lock 2>/dev/null; rm -f "$log"' EXIT
+
+"$locker" --watch-lock "$budget" > "$log" &
+watcher=$!
+
+# start the locker only once the watcher listens
+tries=0
+until grep -q '^ready' "$log"; do
+    tries=$((tries + 1))
+    if [ $tries -gt 100 ] || ! kill -0 $watcher 2>/dev/null; then
+        echo "watcher did not start"
+        exit 1
+    fi
+    sleep 0.1
+done
+
+"$locker" &
+lock=$!
+
+wait $watcher
+status=$?
+cat "$log"
+exit $status
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "textwarmup.h"
+#include "tracepoints.h"
+
+#include <QCoreApplication>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QGlyphRun>
+#include <QGuiApplication>
+#include <QLocale>
+#include <QRawFont>
+#include <QTextLayout>
+
+TextWarmup::~TextWarmup()
+{
+    m_pool.waitForDone();
+}
+
+QList<TextWarmup::Run> TextWarmup::lockScreenText(const QString &userName)
+{
+    const QFont base = QGuiApplication::font();
+    const QLocale locale;
+
+    QFont clock = base;
+    clock.setPointSize(35);
+
+    QFont date = base;
+    date.setPointSize(19);
+
+    QFont notification = base;
+    notification.setBold(true);
+
+    // tomorrow too, the date changes while locked overnight
+    const QDate today = QDate::currentDate();
+
+    return {
+        { clock, QStringLiteral("0123456789:") },
+        { date, locale.toString(today, QLocale::LongFormat) },
+        { date, locale.toString(today.addDays(1), QLocale::LongFormat) },
+        { base, userName },
+        { base, QCoreApplication::translate("LockScreen", "Password") },
+        { notification, QCoreApplication::translate("LockScreen", "Please enter your password") },
+        { notification, QCoreApplication::translate("LockScreen", "Unlocking failed") },
+    };
+}
+
+qint64 TextWarmup::run(const QList<Run> &runs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // fontconfig setup and the font database, once for the process
+    QFontDatabase::families();
+
+    for (const Run &run : runs) {
+        if (run.text.isEmpty()) {
+            continue;
+        }
+
+        // shaping resolves the fallback fonts, e.g. for a user name in another script
+        QTextLayout layout(run.text, run.font);
+        layout.beginLayout();
+        layout.createLine();
+        layout.endLayout();
+
+        const QList<QGlyphRun> glyphRuns = layout.glyphRuns();
+        for (const QGlyphRun &glyphRun : glyphRuns) {
+            const QRawFont font = glyphRun.rawFont();
+            const QList<quint32> glyphs = glyphRun.glyphIndexes();
+            for (quint32 glyph : glyphs) {
+                font.alphaMapForGlyph(glyph);
+            }
+        }
+    }
+
+    return timer.nsecsElapsed();
+}
+
+void TextWarmup::start(const QList<Run> &runs)
+{
+    m_pool.setMaxThreadCount(1);
+    m_pool.start([this, runs] {
+        const qint64 elapsedNs = run(runs);
+        m_elapsedNs.storeRelease(elapsedNs);
+        LOCKER_TRACE1(text_warmup, elapsedNs / 1000);
+    });
+}
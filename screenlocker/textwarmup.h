@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTWARMUP_H
+#define TEXTWARMUP_H
+
+#include <QAtomicInteger>
+#include <QFont>
+#include <QList>
+#include <QThreadPool>
+
+// Font setup and the first glyphs of the lock screen, done on a worker while
+// the views load their QML. Font matching, fallback resolution and the font
+// database are shared by the whole process, so every view finds them ready
+// instead of the first one paying for them before its first frame. With a
+// stale fontconfig cache the scan is the expensive part; fontconfig writes
+// its own cache afterwards, which --warm-caches relies on at install or
+// login time.
+class TextWarmup
+{
+public:
+    struct Run {
+        QFont font;
+        QString text;
+    };
+
+    TextWarmup() = default;
+    ~TextWarmup();
+
+    // Clock digits, date, user name and the translated strings, in the fonts
+    // LockScreen.qml shows them in
+    static QList<Run> lockScreenText(const QString &userName);
+
+    // Returns the time taken in ns
+    static qint64 run(const QList<Run> &runs);
+
+    void start(const QList<Run> &runs);
+
+    // -1 until the worker is done
+    qint64 elapsedNs() const { return m_elapsedNs.loadAcquire(); }
+
+private:
+    Q_DISABLE_COPY(TextWarmup)
+
+    QAtomicInteger<qint64> m_elapsedNs = -1;
+    QThreadPool m_pool;
+};
+
+#endif // TEXTWARMUP_H
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Build-time tool: rasterizes the icons listed in a manifest at every
+// device pixel ratio given and packs them into one PNG, with a JSON table
+// mapping "<name>@<pixel size>" to the rectangle in the atlas.
+//
+// iconatlas <manifest> <images dir> <output png> <output json> <ratio>...
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QSvgRenderer>
+#include <QtMath>
+
+#include <algorithm>
+#include <stdio.h>
+
+static const int s_atlasWidth = 512;
+static const int s_padding = 1;
+
+struct Entry {
+    QString key;
+    QImage image;
+    QRect rect;
+};
+
+int main(int argc, char *argv[])
+{
+    // QPainter needs a gui application for fonts, but nothing is shown
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    if (args.count() < 6) {
+        fprintf(stderr, "usage: iconatlas <manifest> <images dir> <output png> <output json> <ratio>...\n");
+        return 1;
+    }
+
+    QList<qreal> ratios;
+    for (int i = 5; i < args.count(); ++i) {
+        ratios << args.at(i).toDouble();
+    }
+
+    QFile manifest(args.at(1));
+    if (!manifest.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        fprintf(stderr, "iconatlas: cannot read %s\n", qPrintable(args.at(1)));
+        return 1;
+    }
+
+    QList<Entry> entries;
+    while (!manifest.atEnd()) {
+        const QString line = QString::fromUtf8(manifest.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        const QStringList fields = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        const QString file = fields.value(0);
+        const int logicalSize = fields.value(1).toInt();
+
+        QSvgRenderer renderer(args.at(2) + QLatin1Char('/') + file);
+        if (!renderer.isValid() || logicalSize <= 0) {
+            fprintf(stderr, "iconatlas: invalid entry '%s'\n", qPrintable(line));
+            return 1;
+        }
+
+        // "light/media-skip-forward-symbolic.svg" -> "light/media-skip-forward-symbolic"
+        const QString name = file.left(file.length() - 4);
+
+        for (qreal ratio : ratios) {
+            const int pixelSize = qCeil(logicalSize * ratio);
+            const QString key = QStringLiteral("%1@%2").arg(name).arg(pixelSize);
+            if (std::any_of(entries.cbegin(), entries.cend(), [&key](const Entry &e) { return e.key == key; })) {
+                continue;
+            }
+
+            QImage image(pixelSize, pixelSize, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+
+            // keep the aspect ratio, centered like Image.PreserveAspectFit
+            QSizeF size = renderer.defaultSize();
+            size.scale(pixelSize, pixelSize, Qt::KeepAspectRatio);
+            QPainter painter(&image);
+            renderer.render(&painter, QRectF(QPointF((pixelSize - size.width()) / 2, (pixelSize - size.height()) / 2), size));
+            painter.end();
+
+            entries.append({ key, image, QRect() });
+        }
+    }
+
+    // shelf packing, tallest first
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.image.height() > b.image.height();
+    });
+
+    int x = 0;
+    int y = 0;
+    int shelfHeight = 0;
+    for (Entry &entry : entries) {
+        if (x + entry.image.width() > s_atlasWidth) {
+            x = 0;
+            y += shelfHeight + s_padding;
+            shelfHeight = 0;
+        }
+        entry.rect = QRect(QPoint(x, y), entry.image.size());
+        x += entry.image.width() + s_padding;
+        shelfHeight = qMax(shelfHeight, entry.image.height());
+    }
+
+    QImage atlas(s_atlasWidth, y + shelfHeight, QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+
+    QPainter painter(&atlas);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    QJsonObject icons;
+    for (const Entry &entry : std::as_const(entries)) {
+        painter.drawImage(entry.rect.topLeft(), entry.image);
+        icons.insert(entry.key, QJsonArray { entry.rect.x(), entry.rect.y(), entry.rect.width(), entry.rect.height() });
+    }
+    painter.end();
+
+    if (!atlas.save(args.at(3), "PNG")) {
+        fprintf(stderr, "iconatlas: cannot write %s\n", qPrintable(args.at(3)));
+        return 1;
+    }
+
+    QFile table(args.at(4));
+    if (!table.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fprintf(stderr, "iconatlas: cannot write %s\n", qPrintable(args.at(4)));
+        return 1;
+    }
+    table.write(QJsonDocument(QJsonObject { { QStringLiteral("icons"), icons } }).toJson(QJsonDocument::Compact));
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Kills the active greeter of a --split locker <count> times through
+# restartGreeter and prints the respawn latencies with their percentiles.
+# Uses the locker on the session bus, or starts <locker> --split first.
+#
+#   respawnbench.sh <count> [<locker>]
+#
+# CUTEFISH_SCREENLOCKER_BENCH_PAUSE (seconds, default 1) is the pause after
+# each respawn, long enough for the spare greeter to load again. With
+# CUTEFISH_SCREENLOCKER_BENCH_BUDGET_MS above 0 it exits with 1 when the p90
+# latency is over that budget.
+
+count=${1:-20}
+locker=$2
+pause=${CUTEFISH_SCREENLOCKER_BENCH_PAUSE:-1}
+budget=${CUTEFISH_SCREENLOCKER_BENCH_BUDGET_MS:-0}
+samples=$(mktemp)
+trap 'kill $lock 2>/dev/null; rm -f "$samples"' EXIT
+
+call() {
+    gdbus call -e -d com.cutefish.ScreenLocker -o /ScreenLocker -m com.cutefish.ScreenLocker.$1 2>/dev/null | tr -d '(),'
+}
+
+# the first greeter counts as a respawn too, wait for it
+wait_latency() {
+    tries=0
+    while [ "$(call lastRespawnLatency)" = "$1" ]; do
+        tries=$((tries + 1))
+        if [ $tries -gt 200 ]; then
+            return 1
+        fi
+        sleep 0.05
+    done
+}
+
+if [ -n "$locker" ]; then
+    "$locker" --split &
+    lock=$!
+fi
+
+if ! wait_latency "" || ! wait_latency -1.0; then
+    echo "no greeter came up"
+    exit 1
+fi
+sleep "$pause"
+
+i=0
+while [ $i -lt "$count" ]; do
+    previous=$(call lastRespawnLatency)
+    call restartGreeter > /dev/null
+    if ! wait_latency "$previous"; then
+        echo "greeter $i did not come back"
+        exit 1
+    fi
+    call lastRespawnLatency >> "$samples"
+    i=$((i + 1))
+    sleep "$pause"
+done
+
+sort -n "$samples" | awk -v budget="$budget" '
+{ v[NR] = $1 }
+function pct(p) { i = int(NR * p / 100 + 0.5); return v[i < 1 ? 1 : i] }
+END {
+    printf "respawns=%d p50_ms=%.1f p90_ms=%.1f p99_ms=%.1f max_ms=%.1f\n", NR, pct(50), pct(90), pct(99), v[NR]
+    if (budget > 0 && pct(90) > budget) {
+        printf "p90 over the budget of %d ms\n", budget
+        exit 1
+    }
+}'
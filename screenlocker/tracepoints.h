@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+#include <config-screenlocker.h>
+
+// Static tracepoints of the "cutefish_screenlocker" provider, see
+// checkpass/checkpass-trace.h for the helper side. Arguments never
+// carry key codes or any part of the password.
+#if HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define LOCKER_TRACE(name) DTRACE_PROBE(cutefish_screenlocker, name)
+#define LOCKER_TRACE1(name, a) DTRACE_PROBE1(cutefish_screenlocker, name, a)
+#define LOCKER_TRACE2(name, a, b) DTRACE_PROBE2(cutefish_screenlocker, name, a, b)
+#else
+#define LOCKER_TRACE(name) do { } while (0)
+#define LOCKER_TRACE1(name, a) do { (void)(a); } while (0)
+#define LOCKER_TRACE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#endif
+
+#endif // TRACEPOINTS_H
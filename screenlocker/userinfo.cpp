@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "userinfo.h"
+#include "dbusaudit.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDir>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QPainter>
+#include <QScreen>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QtMath>
+
+// system
+#include <pwd.h>
+#include <unistd.h>
+
+static const QString s_accountsService = QStringLiteral("org.freedesktop.Accounts");
+
+static QImage renderAvatar(const QImage &source, int pixelSize)
+{
+    const int side = qMin(source.width(), source.height());
+    const QImage square = source.copy((source.width() - side) / 2, (source.height() - side) / 2, side, side)
+                              .scaled(pixelSize, pixelSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    QImage avatar(pixelSize, pixelSize, QImage::Format_ARGB32_Premultiplied);
+    avatar.fill(Qt::transparent);
+
+    QPainter painter(&avatar);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(square);
+    painter.drawEllipse(avatar.rect());
+    painter.end();
+
+    return avatar;
+}
+
+UserInfo::UserInfo(QObject *parent)
+    : QObject(parent)
+{
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                 + QStringLiteral("/cutefish-screenlocker/account");
+}
+
+UserInfo::~UserInfo()
+{
+    m_pool.waitForDone();
+}
+
+void UserInfo::prefetch()
+{
+    loadCache();
+
+    if (m_userName.isEmpty()) {
+        if (struct passwd *pw = ::getpwuid(::getuid())) {
+            m_userName = QString::fromLocal8Bit(pw->pw_name);
+        }
+    }
+
+    QDBusMessage message = QDBusMessage::createMethodCall(s_accountsService,
+                                                          QStringLiteral("/org/freedesktop/Accounts"),
+                                                          QStringLiteral("org.freedesktop.Accounts"),
+                                                          QStringLiteral("FindUserById"));
+    message << qint64(::getuid());
+
+    auto *watcher = new QDBusPendingCallWatcher(DBusAudit::asyncCall(QDBusConnection::systemBus(), message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &UserInfo::onUserFound);
+}
+
+bool UserInfo::hasAvatar() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_avatars.isEmpty();
+}
+
+QImage UserInfo::avatar(qreal devicePixelRatio) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_avatars.isEmpty()) {
+        return QImage();
+    }
+
+    QImage avatar = m_avatars.value(ratioKey(devicePixelRatio));
+    if (avatar.isNull()) {
+        // Unusual ratio, derive it from the sharpest one we have
+        const int pixelSize = qCeil(AvatarSize * devicePixelRatio);
+        avatar = m_avatars.last().scaled(pixelSize, pixelSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    avatar.setDevicePixelRatio(devicePixelRatio);
+    return avatar;
+}
+
+void UserInfo::loadCache()
+{
+    QSettings settings(m_cacheDir + QStringLiteral("/account.ini"), QSettings::IniFormat);
+    m_userName = settings.value(QStringLiteral("userName")).toString();
+    m_realName = settings.value(QStringLiteral("realName")).toString();
+    m_iconFile = settings.value(QStringLiteral("iconFile")).toString();
+    m_iconModified = settings.value(QStringLiteral("iconModified")).toLongLong();
+
+    QMap<int, QImage> avatars;
+    const QStringList files = QDir(m_cacheDir).entryList({ QStringLiteral("avatar-*.png") }, QDir::Files);
+    for (const QString &file : files) {
+        const int key = file.mid(7, file.length() - 11).toInt();
+        QImage image(m_cacheDir + QLatin1Char('/') + file);
+        if (key > 0 && !image.isNull()) {
+            avatars.insert(key, image);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_avatars = avatars;
+}
+
+void UserInfo::saveCache()
+{
+    QSettings settings(m_cacheDir + QStringLiteral("/account.ini"), QSettings::IniFormat);
+    settings.setValue(QStringLiteral("userName"), m_userName);
+    settings.setValue(QStringLiteral("realName"), m_realName);
+    settings.setValue(QStringLiteral("iconFile"), m_iconFile);
+    settings.setValue(QStringLiteral("iconModified"), m_iconModified);
+}
+
+void UserInfo::onUserFound(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    QDBusPendingReply<QDBusObjectPath> reply = *watcher;
+    if (reply.isError()) {
+        return;
+    }
+
+    QDBusMessage message = QDBusMessage::createMethodCall(s_accountsService,
+                                                          reply.value().path(),
+                                                          QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                          QStringLiteral("GetAll"));
+    message << QStringLiteral("org.freedesktop.Accounts.User");
+
+    auto *propertiesWatcher = new QDBusPendingCallWatcher(DBusAudit::asyncCall(QDBusConnection::systemBus(), message), this);
+    connect(propertiesWatcher, &QDBusPendingCallWatcher::finished, this, &UserInfo::onPropertiesReceived);
+}
+
+void UserInfo::onPropertiesReceived(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    if (reply.isError()) {
+        return;
+    }
+
+    const QVariantMap properties = reply.value();
+    const QString userName = properties.value(QStringLiteral("UserName")).toString();
+    const QString realName = properties.value(QStringLiteral("RealName")).toString();
+    QString iconFile = properties.value(QStringLiteral("IconFile")).toString();
+
+    const QFileInfo iconInfo(iconFile);
+    if (!iconInfo.isFile()) {
+        iconFile.clear();
+    }
+    const qint64 iconModified = iconFile.isEmpty() ? 0 : iconInfo.lastModified().toMSecsSinceEpoch();
+
+    bool avatarsComplete = true;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (QScreen *screen : QGuiApplication::screens()) {
+            avatarsComplete &= m_avatars.contains(ratioKey(screen->devicePixelRatio()));
+        }
+    }
+
+    const bool iconChanged = iconFile != m_iconFile || iconModified != m_iconModified
+                             || (!iconFile.isEmpty() && !avatarsComplete);
+    if (userName == m_userName && realName == m_realName && !iconChanged) {
+        return;
+    }
+
+    m_userName = userName;
+    m_realName = realName;
+    m_iconFile = iconFile;
+    m_iconModified = iconModified;
+
+    QDir().mkpath(m_cacheDir);
+    saveCache();
+
+    if (iconChanged) {
+        renderAvatars(iconFile, iconModified);
+    } else {
+        Q_EMIT changed();
+    }
+}
+
+void UserInfo::renderAvatars(const QString &iconFile, qint64 iconModified)
+{
+    QList<qreal> ratios;
+    for (QScreen *screen : QGuiApplication::screens()) {
+        if (!ratios.contains(screen->devicePixelRatio())) {
+            ratios << screen->devicePixelRatio();
+        }
+    }
+
+    const QString cacheDir = m_cacheDir;
+    m_pool.start([this, iconFile, iconModified, ratios, cacheDir] {
+        QDir dir(cacheDir);
+        const QStringList stale = dir.entryList({ QStringLiteral("avatar-*.png") }, QDir::Files);
+        for (const QString &file : stale) {
+            dir.remove(file);
+        }
+
+        QMap<int, QImage> avatars;
+        if (!iconFile.isEmpty()) {
+            QImageReader reader(iconFile);
+            reader.setAutoTransform(true);
+            const QImage source = reader.read();
+
+            if (!source.isNull()) {
+                for (qreal ratio : ratios) {
+                    const QImage avatar = renderAvatar(source, qCeil(AvatarSize * ratio));
+                    avatar.save(dir.filePath(QStringLiteral("avatar-%1.png").arg(ratioKey(ratio))));
+                    avatars.insert(ratioKey(ratio), avatar);
+                }
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, avatars, iconModified] {
+            // a newer icon may have been seen in the meantime
+            if (iconModified != m_iconModified) {
+                return;
+            }
+
+            {
+                QMutexLocker locker(&m_mutex);
+                m_avatars = avatars;
+            }
+            ++m_avatarRevision;
+            Q_EMIT changed();
+        }, Qt::QueuedConnection);
+    });
+}
+
+int UserInfo::ratioKey(qreal devicePixelRatio)
+{
+    return qRound(devicePixelRatio * 100);
+}
+
+UserAvatarProvider::UserAvatarProvider(UserInfo *userInfo)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , m_userInfo(userInfo)
+{
+}
+
+QImage UserAvatarProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    Q_UNUSED(requestedSize)
+
+    // id is "<revision>/<devicePixelRatio>"
+    const qreal devicePixelRatio = id.section(QLatin1Char('/'), 1, 1).toDouble();
+    const QImage avatar = m_userInfo->avatar(devicePixelRatio > 0 ? devicePixelRatio : 1.0);
+
+    if (size) {
+        *size = avatar.size();
+    }
+    return avatar;
+}
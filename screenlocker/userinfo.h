@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USERINFO_H
+#define USERINFO_H
+
+#include <QObject>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QQuickImageProvider>
+#include <QThreadPool>
+
+class QDBusPendingCallWatcher;
+
+// Name and avatar of the current user for the greeter. The last known
+// values are read from a small on-disk cache at startup, accountsservice
+// is then queried asynchronously and the cache refreshed if anything
+// changed. Avatars are stored pre-cropped and circle-masked for every
+// device pixel ratio in use, so showing them is a single texture upload.
+class UserInfo : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString userName READ userName NOTIFY changed)
+    Q_PROPERTY(QString realName READ realName NOTIFY changed)
+    Q_PROPERTY(bool hasAvatar READ hasAvatar NOTIFY changed)
+    Q_PROPERTY(int avatarRevision READ avatarRevision NOTIFY changed)
+
+public:
+    // Logical size of the avatar in LockScreen.qml
+    static const int AvatarSize = 60;
+
+    explicit UserInfo(QObject *parent = nullptr);
+    ~UserInfo() override;
+
+    void prefetch();
+
+    QString userName() const { return m_userName; }
+    QString realName() const { return m_realName; }
+    bool hasAvatar() const;
+    int avatarRevision() const { return m_avatarRevision; }
+
+    // Thread-safe, called from the image provider
+    QImage avatar(qreal devicePixelRatio) const;
+
+signals:
+    void changed();
+
+private:
+    void loadCache();
+    void saveCache();
+    void onUserFound(QDBusPendingCallWatcher *watcher);
+    void onPropertiesReceived(QDBusPendingCallWatcher *watcher);
+    void renderAvatars(const QString &iconFile, qint64 iconModified);
+
+    static int ratioKey(qreal devicePixelRatio);
+
+private:
+    QString m_cacheDir;
+    QString m_userName;
+    QString m_realName;
+    QString m_iconFile;
+    qint64 m_iconModified = 0;
+    int m_avatarRevision = 0;
+
+    mutable QMutex m_mutex;
+    QMap<int, QImage> m_avatars;
+
+    // Last, so pending renders finish before anything else goes away
+    QThreadPool m_pool;
+};
+
+class UserAvatarProvider : public QQuickImageProvider
+{
+public:
+    explicit UserAvatarProvider(UserInfo *userInfo);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+private:
+    UserInfo *m_userInfo;
+};
+
+#endif // USERINFO_H
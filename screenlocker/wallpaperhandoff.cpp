@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wallpaperhandoff.h"
+#include "dbusaudit.h"
+#include "wallpaperpyramid.h"
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QFileInfo>
+#include <QImageReader>
+
+// system
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const QString s_service = QStringLiteral("com.cutefish.WallpaperHandoff");
+static const QString s_path = QStringLiteral("/WallpaperHandoff");
+
+// The buffer can neither change nor shrink under our mapping
+static const int s_requiredSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+
+WallpaperHandoff::WallpaperHandoff(WallpaperPyramid *pyramid, QObject *parent)
+    : QObject(parent)
+    , m_pyramid(pyramid)
+{
+}
+
+void WallpaperHandoff::request(const QSize &size)
+{
+    if (m_requested.contains(size) || size.isEmpty()) {
+        return;
+    }
+    m_requested << size;
+
+    // the views load their wallpaper on the image thread and wait for this reply
+    m_pyramid->expectHandoff(size);
+
+    QDBusMessage message = QDBusMessage::createMethodCall(s_service, s_path, s_service, QStringLiteral("Buffer"));
+    message << size.width() << size.height();
+    // nothing to wait for when there is no publisher
+    message.setAutoStartService(false);
+
+    auto *watcher = new QDBusPendingCallWatcher(DBusAudit::asyncCall(QDBusConnection::sessionBus(), message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, size](QDBusPendingCallWatcher *watcher) {
+        onReply(watcher, size);
+    });
+}
+
+void WallpaperHandoff::onReply(QDBusPendingCallWatcher *watcher, const QSize &size)
+{
+    watcher->deleteLater();
+
+    QDBusPendingReply<QDBusUnixFileDescriptor, QString, int, int> reply = *watcher;
+    if (reply.isError()) {
+        m_pyramid->cancelHandoff(size);
+        return;
+    }
+
+    const QImage image = import(reply.argumentAt<0>(), size, reply.argumentAt<2>(), reply.argumentAt<3>());
+    if (image.isNull()) {
+        m_pyramid->cancelHandoff(size);
+        return;
+    }
+
+    m_pyramid->handoff(reply.argumentAt<1>(), image);
+}
+
+QImage WallpaperHandoff::import(const QDBusUnixFileDescriptor &fd, const QSize &size, int stride, int format)
+{
+    if (!fd.isValid()) {
+        return QImage();
+    }
+
+    // only formats halve() and the scene graph take as they are
+    if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32_Premultiplied) {
+        qWarning() << "Wallpaper handoff in unsupported format" << format;
+        return QImage();
+    }
+
+    const int seals = ::fcntl(fd.fileDescriptor(), F_GET_SEALS);
+    if (seals < 0 || (seals & s_requiredSeals) != s_requiredSeals) {
+        qWarning() << "Wallpaper handoff buffer is not sealed";
+        return QImage();
+    }
+
+    struct stat info;
+    const qint64 length = qint64(stride) * size.height();
+    if (stride < size.width() * 4 || ::fstat(fd.fileDescriptor(), &info) != 0 || info.st_size < length) {
+        qWarning() << "Wallpaper handoff buffer is too small for" << size;
+        return QImage();
+    }
+
+    void *data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd.fileDescriptor(), 0);
+    if (data == MAP_FAILED) {
+        return QImage();
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    return QImage(static_cast<const uchar *>(data), size.width(), size.height(), stride, QImage::Format(format),
+                  [](void *info) {
+                      auto *mapping = static_cast<QPair<void *, qint64> *>(info);
+                      ::munmap(mapping->first, mapping->second);
+                      delete mapping;
+                  },
+                  new QPair<void *, qint64>(data, length));
+}
+
+WallpaperPublisher::WallpaperPublisher(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_fileName(QFileInfo(fileName).absoluteFilePath())
+{
+    QImageReader reader(m_fileName);
+    reader.setAutoTransform(true);
+    m_image = reader.read();
+    m_image.convertTo(m_image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+WallpaperPublisher::~WallpaperPublisher()
+{
+    for (int fd : std::as_const(m_buffers)) {
+        ::close(fd);
+    }
+}
+
+bool WallpaperPublisher::registerService()
+{
+    if (m_image.isNull()) {
+        qWarning() << "Could not read wallpaper" << m_fileName;
+        return false;
+    }
+
+    return QDBusConnection::sessionBus().registerObject(s_path, this, QDBusConnection::ExportScriptableContents)
+           && DBusAudit::registerService(QDBusConnection::sessionBus(), s_service, "WallpaperPublisher::registerService");
+}
+
+QDBusUnixFileDescriptor WallpaperPublisher::Buffer(int width, int height, QString &path, int &stride, int &format)
+{
+    path = m_fileName;
+    stride = width * 4;
+    format = m_image.format();
+
+    if (width <= 0 || height <= 0) {
+        sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("Invalid size"));
+        return QDBusUnixFileDescriptor();
+    }
+
+    const quint64 key = quint64(width) << 32 | quint32(height);
+    auto it = m_buffers.constFind(key);
+    if (it != m_buffers.constEnd()) {
+        return QDBusUnixFileDescriptor(*it);
+    }
+
+    const QSize size(width, height);
+    const QImage scaled = m_image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    const QImage cropped = scaled.copy((scaled.width() - width) / 2, (scaled.height() - height) / 2, width, height);
+
+    const int fd = ::memfd_create("cutefish-wallpaper", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    bool ok = fd >= 0 && ::ftruncate(fd, qint64(stride) * height) == 0;
+    for (int y = 0; ok && y < height; ++y) {
+        ok = ::pwrite(fd, cropped.constScanLine(y), stride, qint64(y) * stride) == stride;
+    }
+    ok = ok && ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0;
+
+    if (!ok) {
+        const int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        sendErrorReply(QDBusError::Failed, QString::fromLocal8Bit(strerror(error)));
+        return QDBusUnixFileDescriptor();
+    }
+
+    m_buffers.insert(key, fd);
+    return QDBusUnixFileDescriptor(fd);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WALLPAPERHANDOFF_H
+#define WALLPAPERHANDOFF_H
+
+#include <QObject>
+#include <QDBusContext>
+#include <QDBusUnixFileDescriptor>
+#include <QHash>
+#include <QImage>
+
+class QDBusPendingCallWatcher;
+class WallpaperPyramid;
+
+// Asks the desktop shell (com.cutefish.WallpaperHandoff) for the wallpaper
+// it already decoded, scaled to the size of each output. The buffers come
+// as sealed memfds over D-Bus and are mapped read-only straight into the
+// images handed to Qt Quick, so a screen served this way never decodes the
+// file. Without the service, or with a buffer that does not check out, the
+// wallpaper is decoded from disk as before.
+class WallpaperHandoff : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WallpaperHandoff(WallpaperPyramid *pyramid, QObject *parent = nullptr);
+
+    // size in device pixels
+    void request(const QSize &size);
+
+    // Maps a sealed buffer, the image unmaps it when released
+    static QImage import(const QDBusUnixFileDescriptor &fd, const QSize &size, int stride, int format);
+
+private:
+    void onReply(QDBusPendingCallWatcher *watcher, const QSize &size);
+
+private:
+    WallpaperPyramid *m_pyramid;
+    QList<QSize> m_requested;
+};
+
+// Stand-in for the desktop shell side (--publish-wallpaper <file>): decodes
+// the file once and serves it scaled to any requested size.
+class WallpaperPublisher : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.cutefish.WallpaperHandoff")
+
+public:
+    explicit WallpaperPublisher(const QString &fileName, QObject *parent = nullptr);
+    ~WallpaperPublisher() override;
+
+    bool registerService();
+
+public slots:
+    // D-Bus
+    Q_SCRIPTABLE QDBusUnixFileDescriptor Buffer(int width, int height, QString &path, int &stride, int &format);
+
+private:
+    QString m_fileName;
+    QImage m_image;
+    // One sealed memfd per size served, width << 32 | height
+    QHash<quint64, int> m_buffers;
+};
+
+#endif // WALLPAPERHANDOFF_H
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wallpaperpyramid.h"
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QVarLengthArray>
+#include <QtMath>
+
+// Levels below this are not worth keeping, no screen is that small
+static const int s_minLevelEdge = 256;
+
+// Blurred images are halved this many times before the blur passes
+static const int s_blurDownscaleSteps = 2;
+// Radius of each of the three box blur passes, at the downscaled size
+static const int s_blurRadius = 6;
+
+// Per-channel average of two 0xAARRGGBB pixels, rounding down
+static inline quint32 average(quint32 a, quint32 b)
+{
+    return (a & b) + (((a ^ b) & 0xfefefefe) >> 1);
+}
+
+static quint64 sizeKey(const QSize &size)
+{
+    return quint64(size.width()) << 32 | quint32(size.height());
+}
+
+static QSize sizeFromKey(quint64 key)
+{
+    return QSize(int(key >> 32), int(key & 0xffffffff));
+}
+
+WallpaperPyramid::WallpaperPyramid(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_reloadTimer(new QTimer(this))
+{
+    bool ok = false;
+    m_handoffTimeoutMs = qEnvironmentVariableIntValue("CUTEFISH_SCREENLOCKER_HANDOFF_TIMEOUT_MS", &ok);
+    if (!ok) {
+        m_handoffTimeoutMs = 200;
+    }
+
+    // a file is often written in several steps, reload once it settled
+    m_reloadTimer->setObjectName(QStringLiteral("wallpaperReloadTimer"));
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(250);
+    connect(m_reloadTimer, &QTimer::timeout, this, &WallpaperPyramid::reload);
+
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &WallpaperPyramid::onFileChanged);
+
+    m_pool.setMaxThreadCount(1);
+}
+
+WallpaperPyramid::~WallpaperPyramid()
+{
+    m_pool.waitForDone();
+}
+
+void WallpaperPyramid::setPath(const QString &path)
+{
+    // every view tells us
+    if (path == m_requestedPath || path.isEmpty()) {
+        return;
+    }
+    m_requestedPath = path;
+
+    if (!m_watcher->files().isEmpty()) {
+        m_watcher->removePaths(m_watcher->files());
+    }
+    m_watcher->addPath(path);
+
+    if (m_revision == 0) {
+        // the first wallpaper is loaded by the views, it may come as a handoff
+        m_shownPath = path;
+        ++m_revision;
+        Q_EMIT revisionChanged();
+        return;
+    }
+
+    m_reloadTimer->start();
+}
+
+void WallpaperPyramid::onFileChanged(const QString &path)
+{
+    // replacing the file drops it from the watcher
+    if (!m_watcher->files().contains(path) && QFileInfo::exists(path)) {
+        m_watcher->addPath(path);
+    }
+
+    if (path == m_requestedPath) {
+        m_reloadTimer->start();
+    }
+}
+
+void WallpaperPyramid::reload()
+{
+    const QString path = m_requestedPath;
+
+    // everything the views are showing now, to have it ready in one go
+    QSet<quint64> keys;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_derived.constBegin(); it != m_derived.constEnd(); ++it) {
+            keys.insert(it.key());
+        }
+        for (auto it = m_blurred.constBegin(); it != m_blurred.constEnd(); ++it) {
+            keys.insert(it.key());
+        }
+    }
+
+    m_pool.start([this, path, keys] {
+        QElapsedTimer timer;
+        timer.start();
+
+        const qint64 modified = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+        const QList<QImage> levels = decode(path);
+
+        QHash<quint64, QImage> blurredImages;
+        if (!levels.isEmpty()) {
+            for (quint64 key : keys) {
+                blurredImages.insert(key, blurred(derive(levels, sizeFromKey(key))));
+            }
+        }
+
+        const qint64 elapsed = timer.nsecsElapsed();
+        QMetaObject::invokeMethod(this, [this, path, modified, levels, blurredImages, elapsed] {
+            onReloaded(path, modified, levels, blurredImages, elapsed);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void WallpaperPyramid::onReloaded(const QString &path, qint64 modified, const QList<QImage> &levels,
+                                  const QHash<quint64, QImage> &blurred, qint64 elapsedNs)
+{
+    // a newer path is on its way
+    if (path != m_requestedPath) {
+        return;
+    }
+
+    // keep showing the old one
+    if (levels.isEmpty()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_path = path;
+        m_modified = modified;
+        m_levels = levels;
+        ++m_generation;
+        m_derived.clear();
+        m_blurred = blurred;
+        m_handoffs.clear();
+        ++m_decodes;
+        ++m_reloads;
+        m_decodeNs += elapsedNs;
+    }
+
+    m_shownPath = path;
+    ++m_revision;
+    Q_EMIT revisionChanged();
+}
+
+QImage WallpaperPyramid::image(const QString &path, const QSize &size, bool blurred)
+{
+    const qint64 modified = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+    const bool guiThread = QThread::currentThread() == thread();
+
+    // the GUI thread takes the mutex too, image work happens unlocked
+    QMutexLocker locker(&m_mutex);
+    ++m_requests;
+
+    const quint64 key = sizeKey(size);
+
+    // never block the GUI thread, it falls back to decoding instead
+    if (!blurred && !guiThread) {
+        QDeadlineTimer deadline(m_handoffTimeoutMs);
+        while (m_pendingHandoffs.contains(key)) {
+            if (!m_handoffChanged.wait(&m_mutex, deadline)) {
+                // too late to be of use, later requests should not wait either
+                m_pendingHandoffs.remove(key);
+            }
+        }
+    }
+
+    auto handoff = m_handoffs.constFind(key);
+    if (!blurred && handoff != m_handoffs.constEnd() && handoff->path == path) {
+        ++m_handoffHits;
+        return handoff->image;
+    }
+
+    // screens come up together, one decode serves all their threads
+    while (!guiThread && m_decodingPath == path && m_decodingModified == modified) {
+        m_decoded.wait(&m_mutex);
+    }
+
+    QList<QImage> levels;
+    if (path == m_path && modified == m_modified) {
+        levels = m_levels;
+    } else {
+        const bool first = m_decodingPath.isEmpty();
+        if (first) {
+            m_decodingPath = path;
+            m_decodingModified = modified;
+        }
+
+        const int generation = m_generation;
+        locker.unlock();
+        QElapsedTimer timer;
+        timer.start();
+        levels = decode(path);
+        const qint64 elapsed = timer.nsecsElapsed();
+        locker.relock();
+
+        if (!levels.isEmpty()) {
+            ++m_decodes;
+            m_decodeNs += elapsed;
+            // unless a reload or another thread got there first
+            if (generation == m_generation) {
+                m_path = path;
+                m_modified = modified;
+                m_levels = levels;
+                ++m_generation;
+                m_derived.clear();
+                m_blurred.clear();
+            }
+        }
+        if (first) {
+            m_decodingPath.clear();
+            m_decoded.wakeAll();
+        }
+    }
+
+    if (levels.isEmpty()) {
+        return QImage();
+    }
+    if (!size.isValid() || size.isEmpty()) {
+        locker.unlock();
+        return blurred ? WallpaperPyramid::blurred(levels.first()) : levels.first();
+    }
+
+    // only levels that are still the published ones have their sizes cached
+    const int generation = m_generation;
+    if (path == m_path && modified == m_modified) {
+        const QHash<quint64, QImage> &cache = blurred ? m_blurred : m_derived;
+        auto it = cache.constFind(key);
+        if (it != cache.constEnd()) {
+            return *it;
+        }
+    }
+
+    locker.unlock();
+    QElapsedTimer timer;
+    timer.start();
+    QImage result = derive(levels, size);
+    if (blurred) {
+        result = WallpaperPyramid::blurred(result);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    locker.relock();
+
+    m_deriveNs += elapsed;
+    ++m_derivations;
+
+    // the levels may have been replaced meanwhile, keep only what matches them
+    if (generation == m_generation && path == m_path && modified == m_modified) {
+        (blurred ? m_blurred : m_derived).insert(key, result);
+    }
+    return result;
+}
+
+QList<QImage> WallpaperPyramid::decode(const QString &path)
+{
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Could not read wallpaper" << path << reader.errorString();
+        return {};
+    }
+
+    // halve() works on whole 32-bit pixels
+    image.convertTo(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+    QList<QImage> levels { image };
+    while (qMin(levels.last().width(), levels.last().height()) >= 2 * s_minLevelEdge) {
+        levels << halve(levels.last());
+    }
+    return levels;
+}
+
+void WallpaperPyramid::expectHandoff(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pendingHandoffs.insert(sizeKey(size));
+}
+
+void WallpaperPyramid::cancelHandoff(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pendingHandoffs.remove(sizeKey(size));
+    m_handoffChanged.wakeAll();
+}
+
+void WallpaperPyramid::handoff(const QString &path, const QImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    const quint64 key = sizeKey(image.size());
+    m_handoffs.insert(key, { path, image });
+    m_pendingHandoffs.remove(key);
+    m_handoffChanged.wakeAll();
+}
+
+QImage WallpaperPyramid::derive(const QList<QImage> &levels, const QSize &size)
+{
+    const QSize full = levels.first().size();
+
+    // scale that covers the output in both directions, whatever its orientation
+    const qreal scale = qMax(qreal(size.width()) / full.width(), qreal(size.height()) / full.height());
+    const QSize covering(qMax(size.width(), qCeil(full.width() * scale)),
+                         qMax(size.height(), qCeil(full.height() * scale)));
+
+    // smallest level that still has at least as many pixels as we need
+    const QImage *level = &levels.first();
+    for (auto it = levels.crbegin(); it != levels.crend(); ++it) {
+        if (it->width() >= covering.width() && it->height() >= covering.height()) {
+            level = &*it;
+            break;
+        }
+    }
+
+    const QImage scaled = level->size() == covering
+        ? *level
+        : level->scaled(covering, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    // centered crop, like Image.PreserveAspectCrop
+    return scaled.copy((covering.width() - size.width()) / 2,
+                       (covering.height() - size.height()) / 2,
+                       size.width(), size.height());
+}
+
+QImage WallpaperPyramid::halve(const QImage &source)
+{
+    QImage result(source.width() / 2, source.height() / 2, source.format());
+
+    // plain per-pixel arithmetic the compiler vectorizes, a 2x2 box filter
+    for (int y = 0; y < result.height(); ++y) {
+        const quint32 *top = reinterpret_cast<const quint32 *>(source.constScanLine(2 * y));
+        const quint32 *bottom = reinterpret_cast<const quint32 *>(source.constScanLine(2 * y + 1));
+        quint32 *out = reinterpret_cast<quint32 *>(result.scanLine(y));
+
+        for (int x = 0; x < result.width(); ++x) {
+            out[x] = average(average(top[2 * x], top[2 * x + 1]),
+                             average(bottom[2 * x], bottom[2 * x + 1]));
+        }
+    }
+
+    return result;
+}
+
+QImage WallpaperPyramid::blurred(const QImage &source)
+{
+    QImage image = source;
+    for (int i = 0; i < s_blurDownscaleSteps && qMin(image.width(), image.height()) >= 2; ++i) {
+        image = halve(image);
+    }
+
+    // bits() detaches when nothing was halved, source is never written to
+    for (int pass = 0; pass < 3; ++pass) {
+        boxBlur(image, s_blurRadius);
+    }
+
+    return image;
+}
+
+// One box blur pass in each direction with a sliding sum per channel
+void WallpaperPyramid::boxBlur(QImage &image, int radius)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int rowStep = image.bytesPerLine() / 4;
+    auto *bits = reinterpret_cast<quint32 *>(image.bits());
+
+    QVarLengthArray<quint32, 2048> line(qMax(width, height));
+
+    auto blurLine = [radius, &line](quint32 *pixels, int count, int step) {
+        const int window = 2 * radius + 1;
+        quint32 sums[4] = { 0, 0, 0, 0 };
+
+        auto at = [pixels, count, step](int i) {
+            return pixels[qBound(0, i, count - 1) * step];
+        };
+        auto add = [&sums](quint32 pixel, int sign) {
+            for (int c = 0; c < 4; ++c) {
+                sums[c] += sign * int((pixel >> (8 * c)) & 0xff);
+            }
+        };
+
+        for (int i = -radius; i <= radius; ++i) {
+            add(at(i), 1);
+        }
+        for (int i = 0; i < count; ++i) {
+            line[i] = (sums[0] / window) | (sums[1] / window) << 8 | (sums[2] / window) << 16 | (sums[3] / window) << 24;
+            add(at(i + radius + 1), 1);
+            add(at(i - radius), -1);
+        }
+        for (int i = 0; i < count; ++i) {
+            pixels[i * step] = line[i];
+        }
+    };
+
+    for (int y = 0; y < height; ++y) {
+        blurLine(bits + y * rowStep, width, 1);
+    }
+    for (int x = 0; x < width; ++x) {
+        blurLine(bits + x, height, rowStep);
+    }
+}
+
+QString WallpaperPyramid::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonObject root;
+    root.insert(QStringLiteral("path"), m_path);
+    root.insert(QStringLiteral("levels"), m_levels.count());
+    root.insert(QStringLiteral("decodes"), m_decodes);
+    root.insert(QStringLiteral("reloads"), m_reloads);
+    root.insert(QStringLiteral("decodeMs"), m_decodeNs / 1000000.0);
+    root.insert(QStringLiteral("requests"), m_requests);
+    root.insert(QStringLiteral("handoffs"), m_handoffs.count());
+    root.insert(QStringLiteral("handoffHits"), m_handoffHits);
+    root.insert(QStringLiteral("derivations"), m_derivations);
+    root.insert(QStringLiteral("deriveMs"), m_deriveNs / 1000000.0);
+    root.insert(QStringLiteral("outputSizes"), m_derived.count());
+    root.insert(QStringLiteral("blurredSizes"), m_blurred.count());
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+WallpaperProvider::WallpaperProvider(WallpaperPyramid *pyramid)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , m_pyramid(pyramid)
+{
+}
+
+QImage WallpaperProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    // "<revision>/<plain|blurred>/<absolute path>", the revision only busts caches
+    const QString decoded = QUrl::fromPercentEncoding(id.toUtf8());
+    const bool blurred = decoded.section(QLatin1Char('/'), 1, 1) == QLatin1String("blurred");
+    const QString path = QLatin1Char('/') + decoded.section(QLatin1Char('/'), 2);
+
+    const QImage image = m_pyramid->image(path, requestedSize, blurred);
+
+    if (size) {
+        *size = image.size();
+    }
+    return image;
+}
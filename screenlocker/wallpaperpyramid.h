@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 CutefishOS Team.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WALLPAPERPYRAMID_H
+#define WALLPAPERPYRAMID_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QQuickImageProvider>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// The wallpaper, decoded once and halved repeatedly into a mip pyramid that
+// all screens share. A screen gets the image for its exact output size by
+// scaling down the smallest level that still covers it, so screens with
+// different sizes, ratios or orientations cost one decode in total and
+// screens of the same size share the result.
+//
+// Once the views show a wallpaper, a new path or a change to the file is
+// decoded, scaled and blurred for every output size on a worker. The
+// revision only moves on when all of it is ready, so the views switch
+// together and never wait for image I/O.
+class WallpaperPyramid : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString path READ path NOTIFY revisionChanged)
+    Q_PROPERTY(int revision READ revision NOTIFY revisionChanged)
+
+public:
+    explicit WallpaperPyramid(QObject *parent = nullptr);
+    ~WallpaperPyramid() override;
+
+    // The wallpaper the views are to show, and a counter for reloading it
+    QString path() const { return m_shownPath; }
+    int revision() const { return m_revision; }
+
+    Q_INVOKABLE void setPath(const QString &path);
+
+    // Thread-safe, called from the image provider. size is in device
+    // pixels; the result covers it like Image.PreserveAspectCrop. Blurred
+    // images are downscaled, for the views to stretch.
+    QImage image(const QString &path, const QSize &size, bool blurred = false);
+
+    QString report() const;
+
+    // 2x2 box filter on 32-bit pixels
+    static QImage halve(const QImage &source);
+    // Downscaled and run through three box blur passes, like a gaussian
+    static QImage blurred(const QImage &source);
+
+    // Buffers of a cooperating process, see WallpaperHandoff. While one is
+    // expected for a size, image() waits for it off the GUI thread.
+    void expectHandoff(const QSize &size);
+    void cancelHandoff(const QSize &size);
+    void handoff(const QString &path, const QImage &image);
+
+signals:
+    void revisionChanged();
+
+private:
+    void onFileChanged(const QString &path);
+    void reload();
+    void onReloaded(const QString &path, qint64 modified, const QList<QImage> &levels,
+                    const QHash<quint64, QImage> &blurred, qint64 elapsedNs);
+
+    static QList<QImage> decode(const QString &path);
+    static QImage derive(const QList<QImage> &levels, const QSize &size);
+    static void boxBlur(QImage &image, int radius);
+
+private:
+    // GUI thread only
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_reloadTimer;
+    QString m_requestedPath;
+    QString m_shownPath;
+    int m_revision = 0;
+
+    // Held only to look up and publish, never across image work
+    mutable QMutex m_mutex;
+    QWaitCondition m_handoffChanged;
+    QString m_path;
+    qint64 m_modified = 0;
+    // Moves on whenever m_levels is replaced
+    int m_generation = 0;
+
+    // The file an image provider thread is decoding, the others wait for it
+    QWaitCondition m_decoded;
+    QString m_decodingPath;
+    qint64 m_decodingModified = 0;
+
+    // Level 0 is the decoded file, every further level is half the size
+    QList<QImage> m_levels;
+    // Output sizes handed out for the current levels, width << 32 | height
+    QHash<quint64, QImage> m_derived;
+    QHash<quint64, QImage> m_blurred;
+
+    struct Handoff {
+        QString path;
+        QImage image;
+    };
+    QHash<quint64, Handoff> m_handoffs;
+    QSet<quint64> m_pendingHandoffs;
+    int m_handoffTimeoutMs;
+
+    int m_decodes = 0;
+    int m_derivations = 0;
+    int m_requests = 0;
+    int m_handoffHits = 0;
+    qint64 m_decodeNs = 0;
+    qint64 m_deriveNs = 0;
+    int m_reloads = 0;
+
+    // Last, so a running reload finishes before anything else goes away
+    QThreadPool m_pool;
+};
+
+// image://wallpaper/<revision>/<plain|blurred><absolute path>, sourceSize
+// is the output size
+class WallpaperProvider : public QQuickImageProvider
+{
+public:
+    explicit WallpaperProvider(WallpaperPyramid *pyramid);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+private:
+    WallpaperPyramid *m_pyramid;
+};
+
+#endif // WALLPAPERPYRAMID_H
@@ -4,24 +4,31 @@
 <context>
     <name>LockScreen</name>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="202"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="284"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="58"/>
         <source>Password</source>
         <translation>كلمة المرور</translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="225"/>
-        <source>Unlock</source>
-        <translation>إلغاء القُفْل</translation>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="439"/>
+        <source>Too many failed attempts, try again in %1:%2</source>
+        <translation type="unfinished"></translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="274"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="445"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="59"/>
         <source>Please enter your password</source>
         <translation>يُرجى إدخال كلمة المرور</translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="284"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="464"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="60"/>
         <source>Unlocking failed</source>
         <translation>فَشِل إلغاء القُفْل</translation>
     </message>
+    <message>
+        <source>Unlock</source>
+        <translation type="vanished">إلغاء القُفْل</translation>
+    </message>
 </context>
 </TS>
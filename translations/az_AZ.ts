@@ -4,24 +4,31 @@
 <context>
     <name>LockScreen</name>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="202"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="284"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="58"/>
         <source>Password</source>
         <translation>Şifrə</translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="225"/>
-        <source>Unlock</source>
-        <translation>Kiliddən çıxar</translation>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="439"/>
+        <source>Too many failed attempts, try again in %1:%2</source>
+        <translation type="unfinished"></translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="274"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="445"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="59"/>
         <source>Please enter your password</source>
         <translation>Lütfən şifrəni daxil et</translation>
     </message>
     <message>
-        <location filename="../screenlocker/qml/LockScreen.qml" line="284"/>
+        <location filename="../screenlocker/qml/LockScreen.qml" line="464"/>
+        <location filename="../screenlocker/textwarmup.cpp" line="60"/>
         <source>Unlocking failed</source>
         <translation>Kiliddən çıxarıla bilmədi</translation>
     </message>
+    <message>
+        <source>Unlock</source>
+        <translation type="vanished">Kiliddən çıxar</translation>
+    </message>
 </context>
 </TS>